@@ -0,0 +1,115 @@
+#pragma once
+
+#include <memory_resource>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include "MemoryPool.hpp"
+
+namespace Const {
+#ifdef ARENA_BYTES
+    constexpr size_t arenaBytes = ARENA_BYTES;
+#else
+    constexpr size_t arenaBytes = 1 << 20;
+#endif
+};
+
+/**************************************************************************
+Bump pointer arena for objects that all die at the end of a packet burst
+(decoded events, batch vectors, print buffers). Use it directly through
+allocate() or as a std::pmr::memory_resource behind pmr containers,
+deallocate is a no-op and reset() releases everything in O(1).
+
+The buffer is PoolStorage backed (see PoolBacking for huge pages / NUMA). When
+a burst outgrows it the arena falls back to the upstream resource and counts it
+in upstreamAllocations(), those blocks go back on the next reset(). Size the
+arena from highWatermark() so the steady state never reaches upstream.
+One arena per thread, it is not thread-safe.
+**************************************************************************/
+class MonotonicArena : public std::pmr::memory_resource {
+public:
+    explicit MonotonicArena(size_t capacity = Const::arenaBytes, const PoolBacking& backing = {},
+            std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+            : storage_(capacity, backing)
+            , base_(reinterpret_cast<uintptr_t>(storage_.data()))
+            , upstream_(upstream) {
+        std::cout << "MonotonicArena initialized with " << capacity << " bytes\n";
+    }
+    ~MonotonicArena() override {
+        releaseOverflow();
+    }
+    MonotonicArena(const MonotonicArena&) = delete;
+    MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+    // Invalidates everything allocated since the last reset
+    void reset() noexcept {
+        offset_ = 0;
+        if (overflow_) [[unlikely]]
+            releaseOverflow();
+    }
+    void prefault() { storage_.prefault(); }
+
+    size_t used() const { return offset_; }
+    size_t capacity() const { return storage_.size(); }
+    size_t highWatermark() const { return highWatermark_; }
+    uint64_t upstreamAllocations() const { return upstreamAllocations_; }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        const uintptr_t aligned = (base_ + offset_ + alignment - 1) & ~(uintptr_t(alignment) - 1);
+        const size_t end = aligned - base_ + bytes;
+        if (end <= storage_.size()) [[likely]] {
+            offset_ = end;
+            highWatermark_ = std::max(highWatermark_, end);
+            return reinterpret_cast<void*>(aligned);
+        }
+        return allocateOverflow(bytes, alignment);
+    }
+    void do_deallocate(void*, size_t, size_t) override { } // released by reset()
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    // Upstream block with its header in front, chained for release on reset()
+    struct Overflow {
+        Overflow* next;
+        size_t bytes;
+        size_t alignment;
+    };
+    void* allocateOverflow(size_t bytes, size_t alignment) {
+        alignment = std::max(alignment, alignof(Overflow));
+        const size_t header = (sizeof(Overflow) + alignment - 1) & ~(alignment - 1);
+        void* block = upstream_->allocate(header + bytes, alignment);
+        overflow_ = ::new (block) Overflow{ overflow_, header + bytes, alignment };
+        ++upstreamAllocations_;
+        return static_cast<std::byte*>(block) + header;
+    }
+    void releaseOverflow() noexcept {
+        while (overflow_) {
+            Overflow* next = overflow_->next;
+            upstream_->deallocate(overflow_, overflow_->bytes, overflow_->alignment);
+            overflow_ = next;
+        }
+    }
+
+    PoolStorage<std::byte> storage_;
+    const uintptr_t base_;
+    std::pmr::memory_resource* upstream_;
+    size_t offset_ = 0;
+    size_t highWatermark_ = 0;
+    Overflow* overflow_ = nullptr;
+    uint64_t upstreamAllocations_ = 0;
+};
+
+/**************************************************************************
+Resets the arena when the burst scope ends.
+**************************************************************************/
+class ArenaBurst {
+public:
+    explicit ArenaBurst(MonotonicArena& arena) : arena_(arena) { }
+    ~ArenaBurst() { arena_.reset(); }
+    ArenaBurst(const ArenaBurst&) = delete;
+    ArenaBurst& operator=(const ArenaBurst&) = delete;
+private:
+    MonotonicArena& arena_;
+};
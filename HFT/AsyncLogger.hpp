@@ -6,8 +6,15 @@
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
-#include "Queue.hpp"
-#include "MemoryPool.hpp"
+#include <charconv>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <array>
+#include <condition_variable>
+#include "BinaryLog.hpp"
+#include "EventJournal.hpp"
+#include "TscClock.hpp"
 
 namespace Const {
 #ifdef LOG_BUFFER_SIZE
@@ -15,59 +22,598 @@ namespace Const {
 #else
     constexpr size_t LogBufferSize = 512;
 #endif
+#ifdef LOG_STAGING_BYTES
+    constexpr size_t logStagingBytes = LOG_STAGING_BYTES;
+#else
+    constexpr size_t logStagingBytes = 64 << 10;
+#endif
+#ifdef LOG_FLUSH_INTERVAL_US
+    constexpr uint32_t logFlushIntervalUs = LOG_FLUSH_INTERVAL_US;
+#else
+    constexpr uint32_t logFlushIntervalUs = 1000;
+#endif
+#ifdef LOG_CHANNEL_CAPACITY
+    constexpr size_t logChannelCapacity = LOG_CHANNEL_CAPACITY;
+#else
+    constexpr size_t logChannelCapacity = 1 << 10; // messages per producer thread
+#endif
+#ifdef LOG_MAX_CHANNELS
+    constexpr size_t logMaxChannels = LOG_MAX_CHANNELS;
+#else
+    constexpr size_t logMaxChannels = 64; // producer threads alive at once per logger
+#endif
+    constexpr size_t logDrainBatch = 64; // messages per clock read on the logger thread
+#ifdef LOG_SHUTDOWN_TIMEOUT_MS
+    constexpr uint32_t logShutdownTimeoutMs = LOG_SHUTDOWN_TIMEOUT_MS;
+#else
+    constexpr uint32_t logShutdownTimeoutMs = 1000;
+#endif
+#ifdef LOG_MIN_LEVEL
+    constexpr LogLevel logMinLevel = static_cast<LogLevel>(LOG_MIN_LEVEL); // 0 debug, 1 info, 2 warn, 3 error
+#else
+    constexpr LogLevel logMinLevel = LogLevel::Debug;
+#endif
 };
 
+// fmt == nullptr: buffer holds formatted text, or a journal record when record is
+// set. Otherwise a deferred record, buffer holds the arguments encoded per
+// signature (see BinaryLog.hpp)
 struct alignas(64) LogMsg {
     char buffer[Const::LogBufferSize];
     size_t len = 0;
+    uint64_t tsc = 0;         // TscClock::now() at the call
+    uint64_t sequence = 0;    // LogSequence::On only
+    bool leveled = false;     // debug()/info()/warn()/error()
+    LogLevel level = LogLevel::Debug;
+    const char* fmt = nullptr;
+    const char* signature = nullptr;
+    JournalType record = JournalType::None; // journal() only
 };
 
-class AsyncLogger {
+// Text writes "[ns] | line" to the stream, Binary writes a BinaryLog file (open
+// the stream with std::ios::binary) that LogDecoder turns back into text.
+// Journal writes an event journal (EventJournal.hpp) of the journal() records,
+// log lines go in as notes
+enum class LogOutput { Text, Binary, Journal };
+
+// On: every line gets a number from one logger wide counter, taken at the call
+// ("[ns] #seq | line"), so merged multi-thread output can be ordered exactly.
+// It is one shared atomic increment per call, producers contend on it
+enum class LogSequence { Off, On };
+
+// When staged output goes to the stream: once stagingBytes would overflow, or
+// on the first drain at least intervalUs after the previous flush. everyMessage
+// writes and flushes each line on its own (the old behaviour). On destruction
+// the logger keeps draining for up to shutdownTimeoutMs
+struct LogFlushPolicy {
+    size_t stagingBytes = Const::logStagingBytes;
+    uint32_t intervalUs = Const::logFlushIntervalUs;
+    bool everyMessage = false;
+    uint32_t shutdownTimeoutMs = Const::logShutdownTimeoutMs;
+};
+
+// What a call does when its channel is full. DropNewest drops the line and
+// counts it. Block waits up to blockTimeoutUs for room, then drops. Summary
+// drops like DropNewest and the logger thread writes one inline line per
+// channel in its place ("N lines dropped, last: <format>"). In every mode the
+// logger thread writes the drop count every reportIntervalMs while it grows,
+// and a call never throws: threads past logMaxChannels count as dropped too
+enum class LogOverflow { DropNewest, Block, Summary };
+
+struct LogOverflowPolicy {
+    LogOverflow mode = LogOverflow::DropNewest;
+    uint32_t blockTimeoutUs = 100;
+    uint32_t reportIntervalMs = 1000;
+};
+
+// Where the logger thread's staged batches go, one write() per batch. See
+// MmapLogSink.hpp for a memory mapped file with rotation
+class LogSink {
 public:
-    using LogMsgPtr = LogMsg*;
-    AsyncLogger(std::ostream& outStream) 
-            : outStream_(outStream)
-            , runFlag_(true) {
-        
-        loggerThread_ = std::thread(&AsyncLogger::LoggerThread, this);
+    virtual ~LogSink() = default;
+    virtual void write(const char* data, size_t len) = 0;
+    virtual void flush() = 0;
+};
+
+class OstreamLogSink : public LogSink {
+public:
+    explicit OstreamLogSink(std::ostream& out) : out_(out) { }
+    void write(const char* data, size_t len) override { out_.write(data, len); }
+    void flush() override { out_.flush(); }
+private:
+    std::ostream& out_;
+};
+
+/**************************************************************************
+Logger thread staging buffer. Entries are appended in memory and reach the
+sink with one write + flush, so a burst of lines costs one syscall instead
+of one per line. reserve()/commit() let the formatter write in place.
+**************************************************************************/
+class LogStagingBuffer {
+public:
+    LogStagingBuffer(LogSink& out, size_t capacity) : out_(out), buffer_(capacity) { }
+
+    void write(const char* data, size_t len) {
+        if (size_ + len > buffer_.size()) {
+            flush();
+            if (len > buffer_.size()) { // larger than the whole buffer, straight through
+                out_.write(data, len);
+                return;
+            }
+        }
+        std::memcpy(buffer_.data() + size_, data, len);
+        size_ += len;
     }
+    void put(char c) { write(&c, 1); }
+
+    // At least maxLen bytes to write into, flushes first if they are not free
+    char* reserve(size_t maxLen) {
+        if (maxLen > buffer_.size()) 
+            throw std::invalid_argument("Log staging buffer smaller than one entry");
+        if (size_ + maxLen > buffer_.size()) 
+            flush();
+        return buffer_.data() + size_;
+    }
+    void commit(size_t len) { size_ += len; }
+
+    void flush() {
+        if (size_ > 0) {
+            out_.write(buffer_.data(), size_);
+            size_ = 0;
+        }
+        out_.flush();
+        ++flushes_;
+    }
+    size_t size() const { return size_; }
+    uint64_t flushes() const { return flushes_; }
+
+private:
+    LogSink& out_;
+    std::vector<char> buffer_;
+    size_t size_ = 0;
+    uint64_t flushes_ = 0;
+};
+
+/**************************************************************************
+Per producer thread ring of LogMsg slots, written in place. The producer
+claim()s the tail slot, fills it and publish()es it, the logger thread reads
+front() and pop()s it once written out, so there is no pool and no pointer
+queue. Each side caches the other's index and only reloads it when the ring
+looks full (producer) or empty (consumer).
+A channel belongs to one thread at a time, retired when the thread exits and
+handed to the next thread that registers.
+**************************************************************************/
+class LogChannel {
+public:
+    explicit LogChannel(size_t capacity = Const::logChannelCapacity) 
+            : slots_(capacity)
+            , mask_(capacity - 1) {
+        if (capacity == 0 || (capacity & mask_) != 0) {
+            throw std::invalid_argument("Capacity must be a power of two and greater than zero.");
+        }
+    }
+    // Producer side, nullptr when the ring is full
+    LogMsg* claim() {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cachedHead_ > mask_) {
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if (tail - cachedHead_ > mask_) 
+                return nullptr;
+        }
+        return &slots_[tail & mask_];
+    }
+    void publish() {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+    // Consumer side, nullptr when empty
+    LogMsg* front() {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cachedTail_) {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head == cachedTail_) 
+                return nullptr;
+        }
+        return &slots_[head & mask_];
+    }
+    void pop() {
+        head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+    // Positions for the flush barrier: lines published so far and lines popped
+    size_t published() const { return tail_.load(std::memory_order_acquire); }
+    size_t consumed() const { return head_.load(std::memory_order_relaxed); }
+
+    // Producer side, a line that found the ring full. Single writer, no RMW
+    void drop(const char* fmt) {
+        lastDropped_.store(fmt, std::memory_order_relaxed);
+        dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_acquire); }
+    const char* lastDropped() const { return lastDropped_.load(std::memory_order_relaxed); }
+    uint64_t reportedDrops = 0;  // consumer only, for LogOverflow::Summary
+
+    // Ownership, see AsyncLogger::channel()
+    bool tryAcquire() {
+        bool expected = true;
+        return retired_.compare_exchange_strong(expected, false, std::memory_order_acquire);
+    }
+    void retire() { retired_.store(true, std::memory_order_release); }
+
+private:
+    std::vector<LogMsg> slots_;
+    const size_t mask_;
+    std::atomic<bool> retired_{ false };
+    alignas(64) std::atomic<size_t> tail_{ 0 };
+    size_t cachedHead_ = 0;     // producer only
+    std::atomic<uint64_t> dropped_{ 0 };
+    std::atomic<const char*> lastDropped_{ nullptr };
+    alignas(64) std::atomic<size_t> head_{ 0 };
+    size_t cachedTail_ = 0;     // consumer only
+};
+
+/**************************************************************************
+Suppression state of one call site for AsyncLogger::sampled(), rateLimited()
+and firstN(). Keep it static thread_local at the call site (LOG_EVERY_N,
+LOG_RATE_LIMITED and LOG_FIRST_N declare it): plain counters, no atomics,
+constant initialised so the thread_local is a direct %fs access. A
+suppressed call costs a decrement and a branch (sampled) or an increment, an
+rdtsc and a compare (rateLimited, firstN), so windows open on time whatever
+the call rate. Suppressed lines are summarised by a later call through the
+site at least a second after the previous summary, a site that goes quiet
+keeps its count.
+**************************************************************************/
+struct LogSite {
+    uint64_t left = 0;          // lines still allowed: before the next sample, in this window, of the first K
+    uint64_t suppressed = 0;    // since the last summary
+    uint64_t windowStart = 0;   // TSC
+    bool started = false;       // firstN: the first K are out
+};
+
+/**************************************************************************
+log() formats with snprintf on the calling thread. logDeferred() only stores
+the format string pointer and the raw argument bytes, the logger thread formats
+them (Text) or writes them as they are (Binary) and formatting happens offline.
+Deferred format strings must be string literals, they are kept by address.
+
+Every thread logs into its own LogChannel, registered on its first call (takes
+a mutex once), so producers share no writes. Lines are stamped with the TSC at
+the call, the logger thread converts to wall clock ns (TscClock, recalibrated
+in the background every tscCalibrationMs) so queueing delay never shows up in
+the timestamps. The logger thread merges the channels by TSC (by sequence with
+LogSequence::On): lines of one thread always stay in order, across threads
+the order holds among the lines already published. A full channel is handled
+per LogOverflowPolicy, calls never throw. Batches are staged in a
+LogStagingBuffer and written per LogFlushPolicy, a line may sit in memory for
+intervalUs, or until flush() when it has to be on disk before going on. The
+destructor writes out what is still queued, giving up after shutdownTimeoutMs
+with a note of the lines left behind.
+**************************************************************************/
+class AsyncLogger {
+public:
+    AsyncLogger(std::ostream& outStream, LogOutput output = LogOutput::Text, const LogFlushPolicy& flush = {}, 
+            LogSequence sequence = LogSequence::Off, const LogOverflowPolicy& overflow = {}) 
+            : AsyncLogger(std::make_unique<OstreamLogSink>(outStream), nullptr, output, flush, sequence, overflow) { }
+    // The sink must outlive the logger
+    AsyncLogger(LogSink& sink, LogOutput output = LogOutput::Text, const LogFlushPolicy& flush = {}, 
+            LogSequence sequence = LogSequence::Off, const LogOverflowPolicy& overflow = {}) 
+            : AsyncLogger(nullptr, &sink, output, flush, sequence, overflow) { }
+    // Lines published before this point are written out, for up to
+    // flushPolicy.shutdownTimeoutMs, then the sink is flushed
     ~AsyncLogger() {
         runFlag_ = false;
         if (loggerThread_.joinable())
             loggerThread_.join();
-        outStream_.flush();
+    }
+
+    // Barrier: returns once every line published before the call (by any thread
+    // that happens-before it) has gone to the sink and the sink is flushed, false
+    // on timeout. Not for the hot path, it waits on the logger thread
+    bool flush(std::chrono::milliseconds timeout = std::chrono::milliseconds(Const::logShutdownTimeoutMs)) {
+        const uint64_t ticket = flushRequested_.fetch_add(1, std::memory_order_seq_cst) + 1;
+        std::unique_lock<std::mutex> lock(flushMutex_);
+        return flushDone_.wait_for(lock, timeout, [&] { return flushCompleted_ >= ticket; });
+    }
+
+    // Registers the calling thread's channel now instead of on its first log call
+    // (allocates and touches the ring), do it at thread start up. False when
+    // logMaxChannels threads already have one, the thread's lines are dropped
+    bool attachThread() { return channel() != nullptr; }
+
+    uint64_t written() const { return written_.load(std::memory_order_relaxed); }
+    uint64_t flushes() const { return flushes_.load(std::memory_order_relaxed); }
+    size_t channels() const { return channelCount_.load(std::memory_order_acquire); }
+    uint64_t dropped() const {
+        uint64_t total = unattachedDrops_.load(std::memory_order_relaxed);
+        const size_t count = channelCount_.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; ++i) total += channels_[i]->dropped();
+        return total;
     }
 
     template<typename... Args>
     void log(const char* fmt, Args&&... args) {
-        LogMsgPtr msg = pool_.allocate();
+        LogChannel* channel = this->channel();
+        LogMsg* msg = claim(channel, fmt);
         if (!msg) {
-            throw std::runtime_error("Logger Pool Exhausted");
+            return;
         }
-
+        stamp(*msg);
         int len = std::snprintf(msg->buffer, sizeof(msg->buffer), fmt, std::forward<Args>(args)...);
-        if (len < 0) {
-            pool_.deallocate(msg);
-            throw std::runtime_error("Encoding error during formatting");
+        if (len < 0) [[unlikely]] {
+            channel->drop(fmt); // encoding error, counted like an overflow
+            return;
         }
         msg->len = (len < (int)sizeof(msg->buffer)) ? len : (int)sizeof(msg->buffer) - 1;
+        msg->fmt = nullptr;
+        msg->leveled = false;
+        msg->record = JournalType::None;
+        channel->publish();
+    }
+
+    template<typename... Args>
+    void logDeferred(const char* fmt, Args... args) {
+        deferred(nullptr, fmt, args...);
+    }
 
-        queue_.enqueue(msg);
+    // Level-tagged deferred logging. The format is checked against the arguments
+    // at compile time (LogFormat) and the signature and fixed argument bytes are
+    // constants. Levels below Const::logMinLevel (-DLOG_MIN_LEVEL) compile to
+    // nothing, keep their arguments free of side effects so those go too
+    template<LogLevel Level, typename... Args>
+    void logAt(LogFormat<std::type_identity_t<Args>...> fmt, Args... args) {
+        if constexpr (Level >= Const::logMinLevel) {
+            static constexpr LogLevel level = Level;
+            deferred(&level, fmt.str, args...);
+        }
+    }
+    template<typename... Args>
+    void debug(LogFormat<std::type_identity_t<Args>...> fmt, Args... args) { logAt<LogLevel::Debug, Args...>(fmt, args...); }
+    template<typename... Args>
+    void info(LogFormat<std::type_identity_t<Args>...> fmt, Args... args) { logAt<LogLevel::Info, Args...>(fmt, args...); }
+    template<typename... Args>
+    void warn(LogFormat<std::type_identity_t<Args>...> fmt, Args... args) { logAt<LogLevel::Warn, Args...>(fmt, args...); }
+    template<typename... Args>
+    void error(LogFormat<std::type_identity_t<Args>...> fmt, Args... args) { logAt<LogLevel::Error, Args...>(fmt, args...); }
+
+    // Typed event for LogOutput::Journal, copied into the channel slot as it is
+    // and stamped like a log line. Does nothing with the other outputs
+    template<JournalRecord R>
+    void journal(const R& record) {
+        static_assert(sizeof(R) <= Const::LogBufferSize, "Journal record larger than a log slot");
+        if (output_ != LogOutput::Journal) 
+            return;
+        LogChannel* channel = this->channel();
+        LogMsg* msg = claim(channel, R::name);
+        if (!msg) {
+            return;
+        }
+        stamp(*msg);
+        std::memcpy(msg->buffer, &record, sizeof(R));
+        msg->len = sizeof(R);
+        msg->fmt = nullptr;
+        msg->leveled = false;
+        msg->record = R::type;
+        channel->publish();
+    }
+
+    // Logs one call in every, the first one included
+    template<LogLevel Level, typename... Args>
+    void sampled(LogSite& site, uint64_t every, LogFormat<std::type_identity_t<Args>...> fmt, Args... args) {
+        if constexpr (Level >= Const::logMinLevel) {
+            if (site.left-- != 0) [[likely]]
+                return;
+            site.left = every - 1;
+            logAt<Level, Args...>(fmt, args...);
+        }
+    }
+
+    // Logs at most perSecond calls per one second window, perSecond 0 logs none.
+    // The first line of a window is preceded by the count suppressed before it
+    template<LogLevel Level, typename... Args>
+    void rateLimited(LogSite& site, uint64_t perSecond, LogFormat<std::type_identity_t<Args>...> fmt, Args... args) {
+        if constexpr (Level >= Const::logMinLevel) {
+            if (site.left == 0) {
+                const uint64_t now = TscClock::now();
+                if (now - site.windowStart < secondTicks_ || perSecond == 0) [[likely]] {
+                    ++site.suppressed;
+                    return;
+                }
+                site.windowStart = now;
+                site.left = perSecond;
+                summarize<Level>(site, fmt.str);
+            }
+            --site.left;
+            logAt<Level, Args...>(fmt, args...);
+        }
+    }
+
+    // Logs the first K calls, then only a count of the rest once a second
+    template<LogLevel Level, typename... Args>
+    void firstN(LogSite& site, uint64_t first, LogFormat<std::type_identity_t<Args>...> fmt, Args... args) {
+        if constexpr (Level >= Const::logMinLevel) {
+            if (!site.started) [[unlikely]] {
+                site.started = true;
+                site.left = first;
+                site.windowStart = TscClock::now();
+            }
+            if (site.left > 0) [[unlikely]] {
+                --site.left;
+                logAt<Level, Args...>(fmt, args...);
+                return;
+            }
+            ++site.suppressed;
+            if (const uint64_t now = TscClock::now(); now - site.windowStart >= secondTicks_) [[unlikely]] {
+                site.windowStart = now;
+                summarize<Level>(site, fmt.str);
+            }
+        }
     }
 
 private:
+    template<LogLevel Level>
+    void summarize(LogSite& site, const char* fmt) {
+        if (site.suppressed == 0) 
+            return;
+        std::string_view line(fmt);
+        if (!line.empty() && line.back() == '\n') 
+            line.remove_suffix(1);
+        logAt<Level, unsigned long long, std::string_view>("%llu lines suppressed like: %s\n", site.suppressed, line);
+        site.suppressed = 0;
+    }
+
+    template<typename... Args>
+    void deferred(const LogLevel* level, const char* fmt, const Args&... args) {
+        LogChannel* channel = this->channel();
+        LogMsg* msg = claim(channel, fmt);
+        if (!msg) {
+            return;
+        }
+        stamp(*msg);
+        msg->leveled = level != nullptr;
+        if (level) 
+            msg->level = *level;
+        msg->fmt = fmt;
+        msg->record = JournalType::None;
+        msg->signature = LogSignature<Args...>::value;
+        msg->len = encodeLogArgs<sizeof(msg->buffer)>(msg->buffer, args...);
+        channel->publish();
+    }
+
+    AsyncLogger(std::unique_ptr<LogSink> ownedSink, LogSink* sink, LogOutput output, const LogFlushPolicy& flush, 
+            LogSequence sequence, const LogOverflowPolicy& overflow) 
+            : ownedSink_(std::move(ownedSink))
+            , output_(output)
+            , flushPolicy_(flush)
+            , overflow_(overflow)
+            , sequenced_(sequence == LogSequence::On)
+            , staging_(sink ? *sink : *ownedSink_, std::max(flush.stagingBytes, formatBufferSize + 64))
+            , runFlag_(true) {
+        if (output_ == LogOutput::Binary) {
+            binaryWriter_ = std::make_unique<BinaryLogWriter<LogStagingBuffer>>(staging_);
+        }
+        else if (output_ == LogOutput::Journal) {
+            journalWriter_ = std::make_unique<JournalWriter<LogStagingBuffer>>(staging_);
+        }
+        blockTimeoutTicks_ = static_cast<uint64_t>(clock_.ticksPerNs() * overflow_.blockTimeoutUs * 1000);
+        secondTicks_ = static_cast<uint64_t>(clock_.ticksPerNs() * 1e9);
+        loggerThread_ = std::thread(&AsyncLogger::LoggerThread, this);
+    }
+
+    // A free slot, or nullptr with the line counted as dropped
+    LogMsg* claim(LogChannel* channel, const char* fmt) {
+        if (!channel) [[unlikely]] {
+            unattachedDrops_.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        if (LogMsg* msg = channel->claim()) [[likely]] 
+            return msg;
+        if (overflow_.mode == LogOverflow::Block) {
+            const uint64_t start = TscClock::now();
+            do {
+                std::this_thread::yield();
+                if (LogMsg* msg = channel->claim()) 
+                    return msg;
+            } while (TscClock::now() - start < blockTimeoutTicks_);
+        }
+        channel->drop(fmt);
+        return nullptr;
+    }
+
+    void stamp(LogMsg& msg) {
+        msg.tsc = TscClock::now();
+        if (sequenced_) 
+            msg.sequence = nextSequence_.fetch_add(1, std::memory_order_relaxed);
+    }
+    uint64_t nowNs() const { return clock_.toNs(TscClock::now()); } // logger thread only
+
+    // The calling thread's channel. Threads keep (logger id, channel) pairs and
+    // retire their channels on exit, ids are never reused so a pair left behind
+    // by a destroyed logger is never matched again. The logger owns the channels,
+    // threads only hold weak references: a destroyed logger frees its rings even
+    // while the threads that logged to it live on, and their stale pairs are
+    // swept on the next registration
+    struct ThreadChannels {
+        struct Entry {
+            uint64_t loggerId;
+            LogChannel* channel;              // only followed while the logger is alive
+            std::weak_ptr<LogChannel> owner;
+        };
+        std::vector<Entry> entries;
+        ~ThreadChannels() {
+            for (Entry& e : entries) {
+                if (auto channel = e.owner.lock()) 
+                    channel->retire();
+            }
+        }
+    };
+    // nullptr when registration failed (remembered, the thread does not retry)
+    LogChannel* channel() {
+        thread_local ThreadChannels mine;
+        thread_local uint64_t lastId = 0;
+        thread_local LogChannel* last = nullptr;
+        if (lastId == id_) [[likely]] 
+            return last;
+        for (auto& e : mine.entries) {
+            if (e.loggerId == id_) {
+                lastId = id_; last = e.channel;
+                return last;
+            }
+        }
+        std::erase_if(mine.entries, [](const ThreadChannels::Entry& e) { return e.owner.expired(); });
+        std::shared_ptr<LogChannel> channel = registerChannel();
+        if (channel) 
+            mine.entries.push_back({ id_, channel.get(), channel });
+        lastId = id_; last = channel.get();
+        return last;
+    }
+    std::shared_ptr<LogChannel> registerChannel() {
+        std::lock_guard<std::mutex> lock(registerMutex_);
+        for (auto& channel : ownedChannels_) {
+            if (channel->tryAcquire()) 
+                return channel; // left by a thread that exited
+        }
+        const size_t count = channelCount_.load(std::memory_order_relaxed);
+        if (count == Const::logMaxChannels) {
+            return nullptr;
+        }
+        ownedChannels_.push_back(std::make_shared<LogChannel>());
+        channels_[count] = ownedChannels_.back().get();
+        channelCount_.store(count + 1, std::memory_order_release);
+        return ownedChannels_.back();
+    }
+
     void LoggerThread() {
         using namespace std::chrono;
+        const uint64_t flushIntervalNs = uint64_t(flushPolicy_.intervalUs) * 1000;
+        const uint64_t reportIntervalNs = uint64_t(overflow_.reportIntervalMs) * 1'000'000;
+        uint64_t lastFlushNs = 0;
+        uint64_t lastReportNs = nowNs();
+        uint64_t reportedDrops = 0;
         uint32_t spin = 0;
+        uint64_t flushServed = 0;
         while (runFlag_.load()) {
-            if (LogMsgPtr msg = queue_.dequeue()) {
-                auto now = high_resolution_clock::now();
-                outStream_ << "[" << duration_cast<nanoseconds>(now.time_since_epoch()).count() << "] | ";
-                outStream_.write(msg->buffer, msg->len);
-                outStream_.flush();
-                pool_.deallocate(msg);
+            if (clock_.due(TscClock::now())) [[unlikely]] 
+                clock_.recalibrate();
+            if (const uint64_t requested = flushRequested_.load(std::memory_order_seq_cst); requested != flushServed) [[unlikely]] {
+                drainTo(snapshot(), UINT64_MAX); // everything published before the request
+                flushSink();
+                lastFlushNs = nowNs();
+                completeFlush(flushServed = requested);
+            }
+            if (nowNs() - lastReportNs >= reportIntervalNs) [[unlikely]] {
+                reportDrops(reportedDrops, nowNs() - lastReportNs);
+                lastReportNs = nowNs();
+            }
+            if (drain()) {
+                const uint64_t now = nowNs(); // one clock read per batch
+                if (staging_.size() > 0 && now - lastFlushNs >= flushIntervalNs) {
+                    flushSink();
+                    lastFlushNs = now;
+                }
                 spin = 0;
             } 
+            else if (staging_.size() > 0 && nowNs() - lastFlushNs >= flushIntervalNs) {
+                flushSink(); // time threshold reached while idle
+                lastFlushNs = nowNs();
+            }
             else if (++spin < 1000) {
                 std::this_thread::yield();                     // Fast retry (cheap when hot)
             } 
@@ -76,11 +622,236 @@ private:
                 spin = 0;
             }
         }       
+        shutdown(reportedDrops, lastReportNs);
+    }
+
+    // Drains what was published before the destructor ran, bounded by the timeout
+    void shutdown(uint64_t& reportedDrops, uint64_t lastReportNs) {
+        const uint64_t deadline = TscClock::now() + 
+            static_cast<uint64_t>(clock_.ticksPerNs() * flushPolicy_.shutdownTimeoutMs * 1e6);
+        if (const size_t left = drainTo(snapshot(), deadline)) {
+            char line[128];
+            const int len = std::snprintf(line, sizeof(line), "AsyncLogger shutdown timed out after %u ms, %zu lines not written\n", 
+                flushPolicy_.shutdownTimeoutMs, left);
+            writeText(TscClock::now(), line, static_cast<size_t>(len));
+        }
+        reportDrops(reportedDrops, nowNs() - lastReportNs);
+        if (journalWriter_) 
+            journalWriter_->finish();
+        flushSink();
+        completeFlush(UINT64_MAX); // releases any flush() still waiting
+    }
+
+    using Snapshot = std::array<size_t, Const::logMaxChannels>;
+    Snapshot snapshot() const {
+        Snapshot published{};
+        const size_t count = channelCount_.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; ++i) published[i] = channels_[i]->published();
+        return published;
+    }
+    // Drains until every channel got past its snapshot position or the TSC
+    // deadline passes, returns the lines still short of the snapshot
+    size_t drainTo(const Snapshot& target, uint64_t deadline) {
+        const size_t count = channelCount_.load(std::memory_order_acquire);
+        auto remaining = [&] {
+            size_t left = 0;
+            for (size_t i = 0; i < count; ++i) {
+                const size_t consumed = channels_[i]->consumed();
+                if (consumed < target[i]) left += target[i] - consumed;
+            }
+            return left;
+        };
+        const size_t batch = deadline == UINT64_MAX ? Const::logDrainBatch : 1; // a slow sink overshoots by one line
+        size_t left;
+        while ((left = remaining()) > 0 && TscClock::now() < deadline) 
+            drain(batch);
+        return left;
+    }
+    void completeFlush(uint64_t served) {
+        {
+            std::lock_guard<std::mutex> lock(flushMutex_);
+            flushCompleted_ = served;
+        }
+        flushDone_.notify_all();
     }
 
-    std::ostream& outStream_;
+    // Writes up to batch messages, oldest channel front first
+    size_t drain(size_t batch = Const::logDrainBatch) {
+        const size_t count = channelCount_.load(std::memory_order_acquire);
+        size_t drained = 0;
+        while (drained < batch) {
+            LogChannel* oldest = nullptr;
+            LogMsg* oldestMsg = nullptr;
+            for (size_t i = 0; i < count; ++i) {
+                LogMsg* msg = channels_[i]->front();
+                if (msg && (!oldestMsg || older(*msg, *oldestMsg))) {
+                    oldest = channels_[i];
+                    oldestMsg = msg;
+                }
+            }
+            if (!oldestMsg) 
+                break;
+            if (overflow_.mode == LogOverflow::Summary && oldest->dropped() != oldest->reportedDrops) [[unlikely]] 
+                summarizeDrops(*oldest, oldestMsg->tsc);
+            write(*oldestMsg);
+            oldest->pop();
+            ++drained;
+            if (flushPolicy_.everyMessage) 
+                flushSink();
+        }
+        written_.fetch_add(drained, std::memory_order_relaxed);
+        return drained;
+    }
+
+    // "AsyncLogger dropped N lines in the last X ms (T in total)" while the count grows
+    void reportDrops(uint64_t& reported, uint64_t elapsedNs) {
+        const uint64_t total = dropped();
+        if (total == reported) 
+            return;
+        char line[160];
+        const int len = std::snprintf(line, sizeof(line), "AsyncLogger dropped %llu lines in the last %llu ms (%llu in total)\n",
+            (unsigned long long)(total - reported), (unsigned long long)(elapsedNs / 1'000'000), (unsigned long long)total);
+        writeText(TscClock::now(), line, static_cast<size_t>(len));
+        reported = total;
+    }
+    // Written ahead of the channel's next line, stamped just before it
+    void summarizeDrops(LogChannel& channel, uint64_t tsc) {
+        const uint64_t total = channel.dropped();
+        const char* fmt = channel.lastDropped();
+        char line[Const::LogBufferSize];
+        const int len = std::snprintf(line, sizeof(line), "%llu lines dropped, last: %.*s", 
+            (unsigned long long)(total - channel.reportedDrops), 256, fmt ? fmt : "");
+        size_t n = std::min(static_cast<size_t>(len), sizeof(line) - 2);
+        if (n == 0 || line[n - 1] != '\n') line[n++] = '\n';
+        writeText(tsc - 1, line, n);
+        channel.reportedDrops = total;
+    }
+
+    bool older(const LogMsg& a, const LogMsg& b) const {
+        return sequenced_ ? a.sequence < b.sequence : static_cast<int64_t>(a.tsc - b.tsc) < 0;
+    }
+
+    void flushSink() {
+        staging_.flush();
+        flushes_.store(staging_.flushes(), std::memory_order_relaxed);
+    }
+
+    void write(const LogMsg& msg) {
+        const uint64_t timestampNs = clock_.toNs(msg.tsc);
+        if (output_ == LogOutput::Binary) {
+            if (sequenced_) 
+                binaryWriter_->sequence(msg.sequence);
+            if (msg.leveled) 
+                binaryWriter_->level(msg.level);
+            if (msg.fmt) 
+                binaryWriter_->record(timestampNs, msg.fmt, msg.signature, msg.buffer, static_cast<uint16_t>(msg.len));
+            else 
+                binaryWriter_->text(timestampNs, msg.buffer, static_cast<uint16_t>(msg.len));
+            return;
+        }
+        if (output_ == LogOutput::Journal) {
+            if (msg.record != JournalType::None) {
+                journalWriter_->record(msg.record, timestampNs, msg.buffer, msg.len);
+                return;
+            }
+            char note[formatBufferSize];
+            size_t len = 0;
+            if (msg.leveled) 
+                len = std::snprintf(note, sizeof(note), "%s | ", logLevelName(msg.level));
+            if (msg.fmt) {
+                len += formatDeferred(note + len, sizeof(note) - len, msg.fmt, msg.signature, msg.buffer, msg.len);
+            }
+            else {
+                std::memcpy(note + len, msg.buffer, msg.len);
+                len += msg.len;
+            }
+            journalWriter_->note(timestampNs, note, static_cast<uint16_t>(len));
+            return;
+        }
+        char* out = staging_.reserve(prefixBytes + formatBufferSize);
+        char* p = prefix(out, timestampNs, sequenced_ ? &msg.sequence : nullptr);
+        if (msg.leveled) {
+            const char* name = logLevelName(msg.level);
+            const size_t n = std::strlen(name);
+            std::memcpy(p, name, n);
+            std::memcpy(p + n, " | ", 3);
+            p += n + 3;
+        }
+        if (msg.fmt) {
+            p += formatDeferred(p, formatBufferSize, msg.fmt, msg.signature, msg.buffer, msg.len);
+        }
+        else {
+            std::memcpy(p, msg.buffer, msg.len);
+            p += msg.len;
+        }
+        staging_.commit(static_cast<size_t>(p - out));
+    }
+
+    // The logger's own lines, never sequenced
+    void writeText(uint64_t tsc, const char* text, size_t len) {
+        const uint64_t timestampNs = clock_.toNs(tsc);
+        if (output_ == LogOutput::Binary) {
+            binaryWriter_->text(timestampNs, text, static_cast<uint16_t>(len));
+            return;
+        }
+        if (output_ == LogOutput::Journal) {
+            journalWriter_->note(timestampNs, text, static_cast<uint16_t>(len));
+            return;
+        }
+        char* out = staging_.reserve(prefixBytes + len);
+        char* p = prefix(out, timestampNs, nullptr);
+        std::memcpy(p, text, len);
+        staging_.commit(static_cast<size_t>(p + len - out));
+    }
+
+    static constexpr size_t prefixBytes = 64; // "[" uint64 "] #" uint64 " | " level " | "
+    static char* prefix(char* p, uint64_t timestampNs, const uint64_t* sequence) {
+        *p++ = '[';
+        p = std::to_chars(p, p + 20, timestampNs).ptr;
+        *p++ = ']';
+        if (sequence) {
+            std::memcpy(p, " #", 2);
+            p = std::to_chars(p + 2, p + 22, *sequence).ptr;
+        }
+        std::memcpy(p, " | ", 3);
+        return p + 3;
+    }
+
+    inline static std::atomic<uint64_t> nextId_{ 1 };
+    const uint64_t id_ = nextId_.fetch_add(1, std::memory_order_relaxed);
+    std::unique_ptr<LogSink> ownedSink_;                                      // std::ostream constructor only
+    const LogOutput output_;
+    const LogFlushPolicy flushPolicy_;
+    const LogOverflowPolicy overflow_;
+    const bool sequenced_;
+    alignas(64) std::atomic<uint64_t> nextSequence_{ 0 };
+    TscClock clock_;                                                          // logger thread only
+    uint64_t blockTimeoutTicks_ = 0;
+    uint64_t secondTicks_ = 0;                                                // rate limit window
+    static constexpr size_t formatBufferSize = 4 * Const::LogBufferSize; // longest formatted deferred line
+    LogStagingBuffer staging_;                                                // logger thread only
+    std::unique_ptr<BinaryLogWriter<LogStagingBuffer>> binaryWriter_;        // only with LogOutput::Binary
+    std::unique_ptr<JournalWriter<LogStagingBuffer>> journalWriter_;         // only with LogOutput::Journal
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> flushes_{0};
+    std::mutex registerMutex_;
+    std::vector<std::shared_ptr<LogChannel>> ownedChannels_;   // under registerMutex_
+    LogChannel* channels_[Const::logMaxChannels] = {};         // first channelCount_ read by the logger thread
+    std::atomic<size_t> channelCount_{ 0 };
+    std::atomic<uint64_t> unattachedDrops_{ 0 };
+    std::atomic<uint64_t> flushRequested_{ 0 };
+    std::mutex flushMutex_;
+    std::condition_variable flushDone_;
+    uint64_t flushCompleted_ = 0;                              // under flushMutex_
     std::thread loggerThread_;
     alignas(64) std::atomic<bool> runFlag_;
-    Queue<CustomMPMCLockFreeQueue<LogMsgPtr>> queue_;
-    MemoryPool<LockFreeThreadSafePool<LogMsg, true>> pool_;
 };
+
+// One static thread_local LogSite per call site, level is a LogLevel:
+//   LOG_EVERY_N(logger_, LogLevel::Debug, 100000, "MC received msg %llu\n", seq);
+#define LOG_EVERY_N(logger, level, n, ...) \
+    do { static thread_local LogSite logSite_; (logger).template sampled<level>(logSite_, n, __VA_ARGS__); } while (0)
+#define LOG_RATE_LIMITED(logger, level, perSecond, ...) \
+    do { static thread_local LogSite logSite_; (logger).template rateLimited<level>(logSite_, perSecond, __VA_ARGS__); } while (0)
+#define LOG_FIRST_N(logger, level, k, ...) \
+    do { static thread_local LogSite logSite_; (logger).template firstN<level>(logSite_, k, __VA_ARGS__); } while (0)
@@ -0,0 +1,394 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <istream>
+#include <ostream>
+#include <map>
+#include <vector>
+#include <stdexcept>
+
+// Level of the AsyncLogger debug()/info()/warn()/error() calls
+enum class LogLevel : uint8_t { Debug, Info, Warn, Error };
+
+constexpr const char* logLevelName(LogLevel level) {
+    constexpr const char* names[] = { "DEBUG", "INFO", "WARN", "ERROR" };
+    return static_cast<size_t>(level) < std::size(names) ? names[static_cast<size_t>(level)] : "?";
+}
+
+/**************************************************************************
+Deferred log arguments. The caller keeps the format string pointer and copies
+the raw argument bytes, formatting runs later on the logger thread or offline
+from a binary log. Every argument type has a one char code, the codes of a call
+form its signature, built at compile time:
+    b bool, c char, i int32, u uint32, l int64, L uint64, d double (floats
+    widen), s string (uint16 length + bytes), p pointer
+Smaller integers widen to 32 bits like printf varargs. Format strings must
+outlive the logger (string literals), string arguments are copied.
+**************************************************************************/
+template <typename T>
+constexpr char logArgCode() {
+    using U = std::remove_cvref_t<T>;
+    if constexpr (std::is_same_v<U, bool>) return 'b';
+    else if constexpr (std::is_same_v<U, char>) return 'c';
+    else if constexpr (std::is_integral_v<U> && sizeof(U) <= 4) return std::is_signed_v<U> ? 'i' : 'u';
+    else if constexpr (std::is_integral_v<U> && sizeof(U) == 8) return std::is_signed_v<U> ? 'l' : 'L';
+    else if constexpr (std::is_floating_point_v<U> && sizeof(U) <= 8) return 'd';
+    else if constexpr (std::is_convertible_v<U, std::string_view>) return 's'; // const char*, std::string, ...
+    else if constexpr (std::is_pointer_v<U>) return 'p';
+    else return '\0';
+}
+
+template <typename... Args>
+struct LogSignature {
+    static_assert(((logArgCode<Args>() != '\0') && ...), "Unsupported deferred log argument type");
+    static constexpr char value[] = { logArgCode<Args>()..., '\0' };
+    // Bytes taken by everything but string contents
+    static constexpr size_t fixedBytes = (size_t{0} + ... + (logArgCode<Args>() == 's' ? sizeof(uint16_t) :
+        logArgCode<Args>() == 'l' || logArgCode<Args>() == 'L' || logArgCode<Args>() == 'd' ||
+        logArgCode<Args>() == 'p' ? 8 : 4));
+};
+
+template <typename T>
+inline std::string_view logArgView(const T& value) {
+    if constexpr (std::is_pointer_v<T>) 
+        return value ? std::string_view(value) : std::string_view("(null)");
+    else 
+        return std::string_view(value);
+}
+
+// Appends one argument at out, strings are cut to what is left of stringBudget
+template <typename T>
+inline char* encodeLogArg(char* out, size_t& stringBudget, const T& value) {
+    constexpr char code = logArgCode<T>();
+    auto put = [&](auto v) { std::memcpy(out, &v, sizeof(v)); return out + sizeof(v); };
+    if constexpr (code == 'b' || code == 'c' || code == 'i') return put(static_cast<int32_t>(value));
+    else if constexpr (code == 'u') return put(static_cast<uint32_t>(value));
+    else if constexpr (code == 'l') return put(static_cast<int64_t>(value));
+    else if constexpr (code == 'L') return put(static_cast<uint64_t>(value));
+    else if constexpr (code == 'd') return put(static_cast<double>(value));
+    else if constexpr (code == 'p') return put(reinterpret_cast<uint64_t>(value));
+    else {
+        const std::string_view str = logArgView(value);
+        const uint16_t len = static_cast<uint16_t>(std::min({ str.size(), stringBudget, size_t(UINT16_MAX) }));
+        stringBudget -= len;
+        out = put(len);
+        std::memcpy(out, str.data(), len);
+        return out + len;
+    }
+}
+
+// Encodes args into out, returns the bytes used (at most Capacity)
+template <size_t Capacity, typename... Args>
+inline size_t encodeLogArgs(char* out, const Args&... args) {
+    static_assert(LogSignature<Args...>::fixedBytes <= Capacity, "Too many deferred log arguments");
+    [[maybe_unused]] size_t stringBudget = Capacity - LogSignature<Args...>::fixedBytes;
+    char* end = out;
+    ((end = encodeLogArg(end, stringBudget, args)), ...);
+    return static_cast<size_t>(end - out);
+}
+
+/**************************************************************************
+Compile-time checked format string for the level-tagged AsyncLogger calls,
+built like std::format_string from a string literal. The consteval constructor
+walks the printf conversions against the argument signature: the count must
+match (a * width or precision takes an int) and each conversion must suit its
+argument class (integers for diouxXc, floating point for fFeEgGaA, strings for
+s, pointers or strings for p, no %n). Length modifiers are not checked, the
+logger thread re-issues them from the stored type. A bad format fails the
+build at the throw below that names the problem.
+**************************************************************************/
+namespace LogFormatCheck {
+    constexpr bool contains(const char* set, char c) {
+        for (; *set; ++set) if (*set == c) return true;
+        return false;
+    }
+    constexpr bool accepts(char conversion, char code) {
+        if (contains("diouxXc", conversion)) return contains("bciulL", code);
+        if (contains("fFeEgGaA", conversion)) return code == 'd';
+        if (conversion == 's') return code == 's';
+        if (conversion == 'p') return code == 'p' || code == 's';
+        return false;
+    }
+    consteval void check(const char* fmt, const char* signature) {
+        size_t arg = 0;
+        auto next = [&]() -> char {
+            if (!signature[arg]) throw "log format: more conversions than arguments";
+            return signature[arg++];
+        };
+        for (const char* p = fmt; *p; ++p) {
+            if (*p != '%') continue;
+            if (*++p == '%') continue;
+            while (*p && contains("-+ #0'", *p)) ++p;
+            if (*p == '*') { if (!contains("bciu", next())) throw "log format: * width needs an int argument"; ++p; }
+            while (*p >= '0' && *p <= '9') ++p;
+            if (*p == '.') {
+                ++p;
+                if (*p == '*') { if (!contains("bciu", next())) throw "log format: * precision needs an int argument"; ++p; }
+                while (*p >= '0' && *p <= '9') ++p;
+            }
+            while (*p && contains("hljztLq", *p)) ++p;
+            if (!*p) throw "log format: incomplete conversion at the end";
+            if (!accepts(*p, next())) throw "log format: argument type does not match the conversion";
+        }
+        if (signature[arg]) throw "log format: more arguments than conversions";
+    }
+};
+
+template <typename... Args>
+struct LogFormat {
+    template <size_t N>
+    consteval LogFormat(const char (&fmt)[N]) : str(fmt) {
+        LogFormatCheck::check(fmt, LogSignature<Args...>::value);
+    }
+    const char* str;
+};
+
+/**************************************************************************
+printf-style formatting of deferred arguments at runtime. Each conversion is
+re-issued to snprintf with the length modifier taken from the signature, so a
+%d given an int64 or a %s given a number still prints the value instead of
+reading garbage. * widths and precisions consume an int argument as in printf.
+Returns the length written, out is always terminated (snprintf truncation).
+**************************************************************************/
+inline size_t formatDeferred(char* out, size_t size, const char* fmt, const char* signature,
+        const char* args, size_t argBytes) {
+    if (size == 0)
+        return 0;
+    size_t len = 0;
+    const char* const argsEnd = args + argBytes;
+    auto emit = [&](int written) {
+        if (written > 0) len = std::min(len + static_cast<size_t>(written), size - 1);
+    };
+    auto take = [&](auto& value) {
+        if (args + sizeof(value) > argsEnd) return false;
+        std::memcpy(&value, args, sizeof(value));
+        args += sizeof(value);
+        return true;
+    };
+    auto nextInt = [&]() -> int64_t {
+        const char code = *signature ? *signature++ : '\0';
+        if (code == 'l' || code == 'L') { int64_t v = 0; take(v); return v; }
+        if (code == 'b' || code == 'c' || code == 'i' || code == 'u') { int32_t v = 0; take(v); return v; }
+        return 0;
+    };
+
+    for (const char* p = fmt; *p && len < size - 1; ++p) {
+        if (*p != '%') {
+            out[len++] = *p;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[len++] = '%';
+            ++p;
+            continue;
+        }
+        // %[flags][width][.precision][length]conversion, * resolved to the argument value
+        std::string spec = "%";
+        const char* q = p + 1;
+        while (*q && std::strchr("-+ #0'", *q)) spec += *q++;
+        if (*q == '*') { spec += std::to_string(nextInt()); ++q; }
+        while (*q >= '0' && *q <= '9') spec += *q++;
+        if (*q == '.') {
+            spec += *q++;
+            if (*q == '*') { spec += std::to_string(nextInt()); ++q; }
+            while (*q >= '0' && *q <= '9') spec += *q++;
+        }
+        while (*q && std::strchr("hljztLq", *q)) ++q;
+        if (!*q)
+            break;
+        char conv = *q;
+        p = q;
+
+        const char code = *signature ? *signature++ : '\0';
+        const bool intConv = std::strchr("diouxXc", conv) != nullptr;
+        const bool floatConv = std::strchr("fFeEgGaA", conv) != nullptr;
+        if (code == 'b' || code == 'c' || code == 'i' || code == 'u') {
+            uint32_t v = 0; take(v);
+            if (!intConv) conv = (code == 'u') ? 'u' : (code == 'c') ? 'c' : 'd';
+            emit(std::snprintf(out + len, size - len, (spec + conv).c_str(), v));
+        }
+        else if (code == 'l' || code == 'L') {
+            uint64_t v = 0; take(v);
+            if (!intConv || conv == 'c') conv = (code == 'L') ? 'u' : 'd';
+            emit(std::snprintf(out + len, size - len, (spec + "ll" + conv).c_str(), (unsigned long long)v));
+        }
+        else if (code == 'd') {
+            double v = 0; take(v);
+            emit(std::snprintf(out + len, size - len, (spec + (floatConv ? conv : 'g')).c_str(), v));
+        }
+        else if (code == 'p') {
+            uint64_t v = 0; take(v);
+            emit(std::snprintf(out + len, size - len, "%p", reinterpret_cast<void*>(v)));
+        }
+        else if (code == 's') {
+            uint16_t n = 0; take(n);
+            n = static_cast<uint16_t>(std::min<size_t>(n, argsEnd - args));
+            const std::string str(args, n);
+            args += n;
+            emit(std::snprintf(out + len, size - len, (spec + 's').c_str(), str.c_str()));
+        }
+        else {
+            emit(std::snprintf(out + len, size - len, "<missing>"));
+        }
+    }
+    out[len] = '\0';
+    return len;
+}
+
+/**************************************************************************
+Binary log file, native byte order. After the 8 byte magic the file is a
+sequence of entries, each starting with a one char type:
+    'F' format:  uint32 id, uint16 fmt length, uint16 signature length, fmt, signature
+    'R' record:  uint64 timestamp ns, uint32 format id, uint16 arg bytes, args
+    'T' text:    uint64 timestamp ns, uint16 length, preformatted text
+    'N' number:  uint64 sequence number of the next record or text entry
+    'L' level:   uint8 LogLevel of the next record or text entry
+A format entry is written the first time a (fmt, signature) pair is logged,
+records refer to it by id. LogDecoder turns the file back into text.
+**************************************************************************/
+namespace BinaryLog {
+    constexpr char magic[8] = { 'H', 'F', 'T', 'L', 'O', 'G', '1', '\0' };
+    constexpr char formatEntry = 'F';
+    constexpr char recordEntry = 'R';
+    constexpr char textEntry = 'T';
+    constexpr char sequenceEntry = 'N';
+    constexpr char levelEntry = 'L';
+};
+
+// Logger thread side, not thread-safe. Out is anything with put(char) and
+// write(const char*, size): std::ostream or the logger's staging buffer
+template <typename Out = std::ostream>
+class BinaryLogWriter {
+public:
+    explicit BinaryLogWriter(Out& out) : out_(out) {
+        out_.write(BinaryLog::magic, sizeof(BinaryLog::magic));
+    }
+    void record(uint64_t timestampNs, const char* fmt, const char* signature, const char* args, uint16_t argBytes) {
+        const uint32_t id = formatId(fmt, signature);
+        out_.put(BinaryLog::recordEntry);
+        put(timestampNs); put(id); put(argBytes);
+        out_.write(args, argBytes);
+    }
+    void text(uint64_t timestampNs, const char* text, uint16_t len) {
+        out_.put(BinaryLog::textEntry);
+        put(timestampNs); put(len);
+        out_.write(text, len);
+    }
+    void sequence(uint64_t number) {
+        out_.put(BinaryLog::sequenceEntry);
+        put(number);
+    }
+    void level(LogLevel level) {
+        out_.put(BinaryLog::levelEntry);
+        put(static_cast<uint8_t>(level));
+    }
+private:
+    uint32_t formatId(const char* fmt, const char* signature) {
+        auto [it, added] = ids_.try_emplace({ fmt, signature }, static_cast<uint32_t>(ids_.size()));
+        if (added) {
+            const uint16_t fmtLen = static_cast<uint16_t>(std::strlen(fmt));
+            const uint16_t sigLen = static_cast<uint16_t>(std::strlen(signature));
+            out_.put(BinaryLog::formatEntry);
+            put(it->second); put(fmtLen); put(sigLen);
+            out_.write(fmt, fmtLen);
+            out_.write(signature, sigLen);
+        }
+        return it->second;
+    }
+    template <typename T>
+    void put(T value) { out_.write(reinterpret_cast<const char*>(&value), sizeof(value)); }
+
+    Out& out_;
+    std::map<std::pair<const char*, const char*>, uint32_t> ids_; // keyed by address, fmts are literals
+};
+
+class BinaryLogReader {
+public:
+    explicit BinaryLogReader(std::istream& in) : in_(in) {
+        char magic[sizeof(BinaryLog::magic)] = {};
+        in_.read(magic, sizeof(magic));
+        if (!in_ || std::memcmp(magic, BinaryLog::magic, sizeof(magic)) != 0)
+            throw std::runtime_error("Not a binary log file");
+    }
+    // Next record formatted into line, false at the end of the file
+    bool next(uint64_t& timestampNs, std::string& line) {
+        char type;
+        hasSequence_ = false;
+        hasLevel_ = false;
+        while (in_.get(type)) {
+            if (type == BinaryLog::sequenceEntry) {
+                get(sequence_);
+                hasSequence_ = true;
+            }
+            else if (type == BinaryLog::levelEntry) {
+                uint8_t level;
+                get(level);
+                level_ = static_cast<LogLevel>(level);
+                hasLevel_ = true;
+            }
+            else if (type == BinaryLog::formatEntry) {
+                uint32_t id; uint16_t fmtLen, sigLen;
+                get(id); get(fmtLen); get(sigLen);
+                if (formats_.size() <= id) formats_.resize(id + 1);
+                formats_[id].fmt.resize(fmtLen);
+                formats_[id].signature.resize(sigLen);
+                in_.read(formats_[id].fmt.data(), fmtLen);
+                in_.read(formats_[id].signature.data(), sigLen);
+            }
+            else if (type == BinaryLog::recordEntry) {
+                uint32_t id; uint16_t argBytes;
+                get(timestampNs); get(id); get(argBytes);
+                args_.resize(argBytes);
+                in_.read(args_.data(), argBytes);
+                if (!in_ || id >= formats_.size())
+                    throw std::runtime_error("Corrupt binary log record");
+                char buffer[4096];
+                const size_t len = formatDeferred(buffer, sizeof(buffer), formats_[id].fmt.c_str(),
+                    formats_[id].signature.c_str(), args_.data(), argBytes);
+                line.assign(buffer, len);
+                return true;
+            }
+            else if (type == BinaryLog::textEntry) {
+                uint16_t len;
+                get(timestampNs); get(len);
+                line.resize(len);
+                in_.read(line.data(), len);
+                return static_cast<bool>(in_);
+            }
+            else {
+                throw std::runtime_error("Unknown binary log entry");
+            }
+        }
+        return false;
+    }
+    // Sequence number of the entry next() returned, if the logger wrote them
+    bool hasSequence() const { return hasSequence_; }
+    uint64_t sequence() const { return sequence_; }
+    // Level of the entry next() returned, for the level-tagged calls only
+    bool hasLevel() const { return hasLevel_; }
+    LogLevel level() const { return level_; }
+
+private:
+    template <typename T>
+    void get(T& value) { in_.read(reinterpret_cast<char*>(&value), sizeof(value)); }
+
+    struct Format {
+        std::string fmt;
+        std::string signature;
+    };
+    std::istream& in_;
+    std::vector<Format> formats_;
+    std::vector<char> args_;
+    uint64_t sequence_ = 0;
+    bool hasSequence_ = false;
+    LogLevel level_ = LogLevel::Debug;
+    bool hasLevel_ = false;
+};
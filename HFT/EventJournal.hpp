@@ -0,0 +1,430 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ITCHMessages.hpp"
+
+namespace Const {
+#ifdef JOURNAL_INDEX_EVERY
+    constexpr uint64_t journalIndexEvery = JOURNAL_INDEX_EVERY;
+#else
+    constexpr uint64_t journalIndexEvery = 4096;
+#endif
+};
+
+// Record types of the event journal. Values are part of the file format,
+// append new ones, never renumber
+enum class JournalType : uint8_t { None, Note, ItchTrade, Gap, Recovery, BookInsert, BookUpdate, BookCancel };
+
+/**************************************************************************
+Journal record payloads, packed and written as they are. Each one names
+itself and its fields for the schema in the file header, so offline tools
+can read a journal without this header and a reader can skip types it does
+not know.
+Field types: u64 i32 f64 b (bool) c (char).
+**************************************************************************/
+#pragma pack(push,1)
+struct JournalItchTrade {
+    static constexpr JournalType type = JournalType::ItchTrade;
+    static constexpr const char* name = "ItchTrade";
+    static constexpr const char* fields = "type:c seq:u64 trade:u64 ts:u64 px:f64 qty:f64 maker:b best:b";
+    ITCHTradeMsg msg;
+};
+struct JournalGap {                 // sequence numbers from..to missing on the feed
+    static constexpr JournalType type = JournalType::Gap;
+    static constexpr const char* name = "Gap";
+    static constexpr const char* fields = "from:u64 to:u64";
+    uint64_t from;
+    uint64_t to;
+};
+struct JournalRecovery {            // recovery of from..to finished, recovered messages replayed
+    static constexpr JournalType type = JournalType::Recovery;
+    static constexpr const char* name = "Recovery";
+    static constexpr const char* fields = "from:u64 to:u64 recovered:u64";
+    uint64_t from;
+    uint64_t to;
+    uint64_t recovered;
+};
+struct JournalBookInsert {
+    static constexpr JournalType type = JournalType::BookInsert;
+    static constexpr const char* name = "BookInsert";
+    static constexpr const char* fields = "order:u64 px:f64 qty:i32 buy:b";
+    uint64_t order_id;
+    double price;
+    int32_t quantity;
+    bool is_buy;
+};
+struct JournalBookUpdate {
+    static constexpr JournalType type = JournalType::BookUpdate;
+    static constexpr const char* name = "BookUpdate";
+    static constexpr const char* fields = "order:u64 qty:i32";
+    uint64_t order_id;
+    int32_t quantity;
+};
+struct JournalBookCancel {
+    static constexpr JournalType type = JournalType::BookCancel;
+    static constexpr const char* name = "BookCancel";
+    static constexpr const char* fields = "order:u64";
+    uint64_t order_id;
+};
+#pragma pack(pop)
+
+template <typename R>
+concept JournalRecord = std::is_trivially_copyable_v<R> && requires {
+    { R::type } -> std::convertible_to<JournalType>;
+    { R::name } -> std::convertible_to<const char*>;
+    { R::fields } -> std::convertible_to<const char*>;
+};
+
+/**************************************************************************
+Event journal file, native byte order:
+    header:  8 byte magic, uint16 version, uint8 type count, then per type
+             uint8 type, uint16 payload size (0: uint16 length prefixed),
+             uint8 name length, name, uint8 fields length, fields
+    records: uint8 type, uint64 timestamp ns, payload
+    footer:  index entries { uint64 record number, uint64 offset, uint64
+             timestamp ns }, one every journalIndexEvery records, then the
+             trailer { uint64 index offset, uint64 entries, uint64 records,
+             8 byte index magic }
+Note records carry text (log lines written to a journal). The footer is
+written when the journal is closed, a journal cut short has no trailer and
+is read up to its last complete record.
+**************************************************************************/
+namespace Journal {
+    constexpr char magic[8] = { 'H', 'F', 'T', 'J', 'R', 'N', '1', '\0' };
+    constexpr char indexMagic[8] = { 'H', 'F', 'T', 'J', 'I', 'D', 'X', '\0' };
+    constexpr uint16_t version = 1;
+    constexpr size_t recordHeaderBytes = sizeof(uint8_t) + sizeof(uint64_t);
+
+    struct IndexEntry {
+        uint64_t record;
+        uint64_t offset;
+        uint64_t timestampNs;
+    };
+    struct Trailer {
+        uint64_t indexOffset;
+        uint64_t entries;
+        uint64_t records;
+        char magic[8];
+    };
+
+    struct TypeInfo {
+        JournalType type;
+        uint16_t size;
+        const char* name;
+        const char* fields;
+    };
+    template <JournalRecord R>
+    constexpr TypeInfo info() { return { R::type, sizeof(R), R::name, R::fields }; }
+    constexpr TypeInfo schema[] = {
+        { JournalType::Note, 0, "Note", "text" },
+        info<JournalItchTrade>(), info<JournalGap>(), info<JournalRecovery>(),
+        info<JournalBookInsert>(), info<JournalBookUpdate>(), info<JournalBookCancel>(),
+    };
+};
+
+// Writes the schema header on construction, then one type byte and the ns
+// timestamp ahead of each payload (notes add a uint16 length). Every
+// journalIndexEvery-th record's number, offset and timestamp are kept in
+// memory, finish() appends them and the trailer that locates them. Single
+// writer (the logger thread); Out needs write(const char*, size)
+template <typename Out = std::ostream>
+class JournalWriter {
+public:
+    explicit JournalWriter(Out& out) : out_(out) {
+        out_.write(Journal::magic, sizeof(Journal::magic));
+        put(Journal::version);
+        put(static_cast<uint8_t>(std::size(Journal::schema)));
+        offset_ = sizeof(Journal::magic) + sizeof(Journal::version) + sizeof(uint8_t);
+        for (const Journal::TypeInfo& info : Journal::schema) {
+            const uint8_t nameLen = static_cast<uint8_t>(std::strlen(info.name));
+            const uint8_t fieldsLen = static_cast<uint8_t>(std::strlen(info.fields));
+            put(info.type); put(info.size);
+            put(nameLen); out_.write(info.name, nameLen);
+            put(fieldsLen); out_.write(info.fields, fieldsLen);
+            offset_ += sizeof(info.type) + sizeof(info.size) + 2 + nameLen + fieldsLen;
+        }
+    }
+    template <JournalRecord R>
+    void record(uint64_t timestampNs, const R& record) {
+        this->record(R::type, timestampNs, reinterpret_cast<const char*>(&record), sizeof(R));
+    }
+    // payload is size bytes of the record struct registered for type
+    void record(JournalType type, uint64_t timestampNs, const char* payload, size_t size) {
+        index(timestampNs);
+        put(type); put(timestampNs);
+        out_.write(payload, size);
+        offset_ += Journal::recordHeaderBytes + size;
+    }
+    void note(uint64_t timestampNs, const char* text, uint16_t len) {
+        index(timestampNs);
+        put(JournalType::Note); put(timestampNs); put(len);
+        out_.write(text, len);
+        offset_ += Journal::recordHeaderBytes + sizeof(len) + len;
+    }
+    // Index footer, nothing may be written after it
+    void finish() {
+        Journal::Trailer trailer{ offset_, index_.size(), records_, {} };
+        std::memcpy(trailer.magic, Journal::indexMagic, sizeof(trailer.magic));
+        out_.write(reinterpret_cast<const char*>(index_.data()), index_.size() * sizeof(Journal::IndexEntry));
+        put(trailer);
+    }
+    uint64_t records() const { return records_; }
+
+private:
+    void index(uint64_t timestampNs) {
+        if (records_++ % Const::journalIndexEvery == 0)
+            index_.push_back({ records_ - 1, offset_, timestampNs });
+    }
+    template <typename T>
+    void put(T value) { out_.write(reinterpret_cast<const char*>(&value), sizeof(value)); }
+
+    Out& out_;
+    uint64_t offset_ = 0;
+    uint64_t records_ = 0;
+    std::vector<Journal::IndexEntry> index_;
+};
+
+/**************************************************************************
+Reads a journal in place: a file is mmapped (read only, sequential), a buffer
+is used as it is, records are visited without copying the file. replay() hands
+every record to visitor(timestampNs, const Record&) for the record types the
+visitor takes (std::string_view for notes) and skips the rest, in file order,
+so the same journal always replays the same way. fromNs starts at the index
+entry before that time instead of the first record, replay stops at the first
+record after untilNs.
+**************************************************************************/
+class JournalReader {
+public:
+    explicit JournalReader(const std::string& path) {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            throw std::runtime_error("Cannot open journal " + path);
+        struct stat st {};
+        ::fstat(fd, &st);
+        size_ = static_cast<size_t>(st.st_size);
+        void* p = size_ ? ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0) : MAP_FAILED;
+        ::close(fd);
+        if (p == MAP_FAILED)
+            throw std::runtime_error("Cannot map journal " + path);
+        ::madvise(p, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(p);
+        mapped_ = true;
+        parse();
+    }
+    JournalReader(const char* data, size_t size) : data_(data), size_(size) { parse(); }
+    ~JournalReader() {
+        if (mapped_)
+            ::munmap(const_cast<char*>(data_), size_);
+    }
+    JournalReader(const JournalReader&) = delete;
+    JournalReader& operator=(const JournalReader&) = delete;
+
+    template <typename Visitor>
+    uint64_t replay(Visitor&& visitor, uint64_t fromNs = 0, uint64_t untilNs = UINT64_MAX) const {
+        size_t offset = recordsBegin_;
+        if (fromNs > 0 && !index_.empty()) {
+            auto it = std::upper_bound(index_.begin(), index_.end(), fromNs,
+                [](uint64_t ns, const Journal::IndexEntry& entry) { return ns < entry.timestampNs; });
+            if (it != index_.begin())
+                offset = (--it)->offset;
+        }
+        uint64_t visited = 0;
+        while (offset + Journal::recordHeaderBytes <= recordsEnd_) {
+            const JournalType type = static_cast<JournalType>(data_[offset]);
+            uint64_t timestampNs;
+            std::memcpy(&timestampNs, data_ + offset + 1, sizeof(timestampNs));
+            const char* payload = data_ + offset + Journal::recordHeaderBytes;
+            size_t size = sizes_[static_cast<uint8_t>(type)];
+            if (size == variableSize) {
+                uint16_t len = 0;
+                if (payload + sizeof(len) > data_ + recordsEnd_)
+                    break;
+                std::memcpy(&len, payload, sizeof(len));
+                payload += sizeof(len);
+                size = len;
+            }
+            else if (size == unknownSize) {
+                throw std::runtime_error("Corrupt journal record");
+            }
+            if (payload + size > data_ + recordsEnd_)
+                break; // cut short, no trailer
+            offset = static_cast<size_t>(payload + size - data_);
+            if (timestampNs > untilNs)
+                break;
+            if (timestampNs < fromNs)
+                continue;
+            ++visited;
+            switch (type) {
+                case JournalType::Note:
+                    if constexpr (std::is_invocable_v<Visitor, uint64_t, std::string_view>)
+                        visitor(timestampNs, std::string_view(payload, size));
+                    break;
+                case JournalType::ItchTrade: visit<JournalItchTrade>(visitor, timestampNs, payload); break;
+                case JournalType::Gap: visit<JournalGap>(visitor, timestampNs, payload); break;
+                case JournalType::Recovery: visit<JournalRecovery>(visitor, timestampNs, payload); break;
+                case JournalType::BookInsert: visit<JournalBookInsert>(visitor, timestampNs, payload); break;
+                case JournalType::BookUpdate: visit<JournalBookUpdate>(visitor, timestampNs, payload); break;
+                case JournalType::BookCancel: visit<JournalBookCancel>(visitor, timestampNs, payload); break;
+                default: break; // newer writer
+            }
+        }
+        return visited;
+    }
+
+    bool complete() const { return complete_; }                  // trailer present
+    uint64_t records() const { return records_; }                // from the trailer
+    const std::vector<Journal::IndexEntry>& index() const { return index_; }
+    size_t bytes() const { return size_; }
+
+private:
+    static constexpr size_t variableSize = 0;
+    static constexpr size_t unknownSize = SIZE_MAX;
+
+    template <JournalRecord R, typename Visitor>
+    static void visit(Visitor& visitor, uint64_t timestampNs, const char* payload) {
+        if constexpr (std::is_invocable_v<Visitor, uint64_t, const R&>) {
+            R record;
+            std::memcpy(&record, payload, sizeof(R));
+            visitor(timestampNs, static_cast<const R&>(record));
+        }
+    }
+
+    void parse() {
+        sizes_.fill(unknownSize);
+        size_t offset = 0;
+        auto get = [&](auto& value) {
+            if (offset + sizeof(value) > size_)
+                throw std::runtime_error("Truncated journal header");
+            std::memcpy(&value, data_ + offset, sizeof(value));
+            offset += sizeof(value);
+        };
+        auto skip = [&](size_t n) {
+            if (offset + n > size_)
+                throw std::runtime_error("Truncated journal header");
+            offset += n;
+        };
+        if (size_ < sizeof(Journal::magic) || std::memcmp(data_, Journal::magic, sizeof(Journal::magic)) != 0)
+            throw std::runtime_error("Not a journal file");
+        offset = sizeof(Journal::magic);
+        uint16_t version;
+        uint8_t types;
+        get(version);
+        get(types);
+        if (version != Journal::version)
+            throw std::runtime_error("Unsupported journal version");
+        for (uint8_t i = 0; i < types; ++i) {
+            uint8_t type, nameLen, fieldsLen;
+            uint16_t size;
+            get(type); get(size);
+            get(nameLen);
+            const std::string_view name(data_ + offset, std::min<size_t>(nameLen, size_ - offset));
+            skip(nameLen);
+            get(fieldsLen); skip(fieldsLen);
+            for (const Journal::TypeInfo& known : Journal::schema) {
+                if (static_cast<uint8_t>(known.type) == type && (known.size != size || name != known.name))
+                    throw std::runtime_error("Journal schema mismatch for " + std::string(name));
+            }
+            sizes_[type] = size;
+        }
+        recordsBegin_ = offset;
+        recordsEnd_ = size_;
+        if (size_ >= offset + sizeof(Journal::Trailer)) {
+            Journal::Trailer trailer;
+            std::memcpy(&trailer, data_ + size_ - sizeof(trailer), sizeof(trailer));
+            const uint64_t indexBytes = trailer.entries * sizeof(Journal::IndexEntry);
+            if (std::memcmp(trailer.magic, Journal::indexMagic, sizeof(trailer.magic)) == 0 &&
+                    trailer.indexOffset >= offset && trailer.indexOffset + indexBytes + sizeof(trailer) == size_) {
+                index_.resize(trailer.entries);
+                std::memcpy(index_.data(), data_ + trailer.indexOffset, indexBytes);
+                recordsEnd_ = trailer.indexOffset;
+                records_ = trailer.records;
+                complete_ = true;
+            }
+        }
+    }
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;
+    bool complete_ = false;
+    size_t recordsBegin_ = 0;
+    size_t recordsEnd_ = 0;
+    uint64_t records_ = 0;
+    std::array<size_t, 256> sizes_;
+    std::vector<Journal::IndexEntry> index_;
+};
+
+/**************************************************************************
+Replay visitor applying the book records to an OrderBook<false> (or any book
+with insert, find and update/cancel taking the found order). The orders live here, the book keeps
+pointers to them, cancelled slots are reused.
+
+The book is only whole when replayed from the start of the journal. From a
+later fromNs the orders inserted before it are missing: their updates and
+cancels are skipped and counted in skipped().
+    OrderBook<false> book;
+    JournalBookReplay replayBook(book);
+    reader.replay(replayBook);
+**************************************************************************/
+template <typename Book>
+class JournalBookReplay {
+public:
+    using OrderT = std::remove_pointer_t<typename Book::OrderPtr>;
+    explicit JournalBookReplay(Book& book) : book_(book) { }
+
+    void operator()(uint64_t, const JournalBookInsert& record) {
+        OrderT* order;
+        if (!free_.empty()) {
+            order = free_.back();
+            free_.pop_back();
+        }
+        else {
+            order = &orders_.emplace_back();
+        }
+        order->order_id = record.order_id;
+        order->price = record.price;
+        order->quantity = record.quantity;
+        order->is_buy = record.is_buy;
+        book_.insert(order);
+    }
+    void operator()(uint64_t, const JournalBookUpdate& record) {
+        OrderT* order = book_.find(record.order_id);
+        if (order == nullptr) [[unlikely]] {
+            ++skipped_;
+            return;
+        }
+        book_.update(order, record.quantity);
+    }
+    void operator()(uint64_t, const JournalBookCancel& record) {
+        OrderT* order = book_.find(record.order_id);
+        if (order == nullptr) [[unlikely]] {
+            ++skipped_;
+            return;
+        }
+        book_.cancel(order);
+        free_.push_back(order);
+    }
+    // Updates and cancels of orders not in the book (inserted before the replay start)
+    uint64_t skipped() const { return skipped_; }
+
+private:
+    Book& book_;
+    std::deque<OrderT> orders_;
+    std::vector<OrderT*> free_;
+    uint64_t skipped_ = 0;
+};
@@ -1,5 +1,11 @@
 #pragma once
 
+#include <cstdint>
+#include <cstddef>
+#include <charconv>
+#include <cstring>
+#include <string_view>
+
 #pragma pack(push,1)
 struct ITCHTradeMsg {
     char message_type;          // 'P' for trade message
@@ -23,4 +29,45 @@ using ITCHTradeMsgPtr = ITCHTradeMsg*;
 using ITCHGapRequestMsgPtr = ITCHGapRequestMsg*;
 
 constexpr size_t ITCHTradeMsgSize = sizeof(ITCHTradeMsg);
-constexpr size_t ITCHGapRequestMsgSize = sizeof(ITCHGapRequestMsg);
\ No newline at end of file
+constexpr size_t ITCHGapRequestMsgSize = sizeof(ITCHGapRequestMsg);
+
+/**************************************************************************
+Decodes one trade CSV line (trade id, price, qty, quote qty, timestamp,
+buyer is maker, best match) straight into msg with std::from_chars, no
+temporary strings or streams so it can run on the hot path without touching
+the heap. Returns false on a malformed line and leaves msg untouched.
+**************************************************************************/
+inline bool decodeTradeCsv(std::string_view line, uint64_t sequence, ITCHTradeMsg& msg) {
+    const char* pos = line.data();
+    const char* const end = line.data() + line.size();
+    auto field = [&](auto& value) {
+        const auto [ptr, ec] = std::from_chars(pos, end, value);
+        if (ec != std::errc() || (ptr != end && *ptr != ','))
+            return false;
+        pos = (ptr == end) ? end : ptr + 1;
+        return true;
+    };
+    auto flag = [&](bool& value) {
+        const char* comma = static_cast<const char*>(std::memchr(pos, ',', end - pos));
+        const std::string_view token(pos, (comma ? comma : end) - pos);
+        value = token.starts_with("True");
+        pos = comma ? comma + 1 : end;
+        return !token.empty();
+    };
+    // Fields of the packed struct cannot bind to references, decode into locals
+    uint64_t tradeId = 0, timestamp = 0;
+    double price = 0.0, quantity = 0.0, quoteQty = 0.0; // quoteQty is skipped, it is price*quantity
+    bool buyerIsMaker = false, bestMatch = false;
+    if (!(field(tradeId) && field(price) && field(quantity) && field(quoteQty) &&
+            field(timestamp) && flag(buyerIsMaker) && flag(bestMatch)))
+        return false;
+    msg.message_type = 'P';
+    msg.sequence_number = sequence;
+    msg.trade_id = tradeId;
+    msg.timestamp = timestamp;
+    msg.price = price;
+    msg.quantity = quantity;
+    msg.buyer_is_maker = buyerIsMaker;
+    msg.best_match = bestMatch;
+    return true;
+}
@@ -0,0 +1,54 @@
+// g++ -std=c++20 -O3 JournalReplay.cpp -o JournalReplay
+// ./JournalReplay session.journal [until ns]
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include "EventJournal.hpp"
+#include "OrderBook.hpp"
+
+/**************************************************************************
+Replays an event journal (AsyncLogger with LogOutput::Journal) offline: book
+records go into an OrderBook, trades, gaps and recoveries are counted, notes
+are printed. Prints the book as of the last record (or of until ns) and the
+replay rate.
+**************************************************************************/
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <journal> [until ns]\n";
+        return 1;
+    }
+    try {
+        const JournalReader reader(argv[1]);
+        const uint64_t untilNs = argc > 2 ? std::stoull(argv[2]) : UINT64_MAX;
+        auto book = std::make_unique<OrderBook<false>>();
+        JournalBookReplay replayBook(*book);
+        struct Session {
+            JournalBookReplay<OrderBook<false>>& book;
+            uint64_t trades = 0, gaps = 0, recovered = 0, notes = 0;
+            double volume = 0.0;
+            void operator()(uint64_t ns, const JournalBookInsert& r) { book(ns, r); }
+            void operator()(uint64_t ns, const JournalBookUpdate& r) { book(ns, r); }
+            void operator()(uint64_t ns, const JournalBookCancel& r) { book(ns, r); }
+            void operator()(uint64_t, const JournalItchTrade& r) { ++trades; volume += r.msg.quantity; }
+            void operator()(uint64_t, const JournalGap&) { ++gaps; }
+            void operator()(uint64_t, const JournalRecovery& r) { recovered += r.recovered; }
+            void operator()(uint64_t ns, std::string_view text) { ++notes; std::cout << "[" << ns << "] " << text; }
+        } session{ replayBook };
+
+        const auto start = std::chrono::steady_clock::now();
+        const uint64_t records = reader.replay(session, 0, untilNs);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        book->print(std::cout, argv[1]);
+        std::cout << std::defaultfloat << "Replayed " << records << " records (" << (reader.complete() ? "indexed" : "no index footer, cut short?")
+            << ") in " << seconds * 1e3 << " ms, " << records / seconds / 1e6 << " M records/s\n";
+        std::cout << "Trades " << session.trades << " volume " << session.volume << ", gaps " << session.gaps 
+            << " recovered " << session.recovered << ", notes " << session.notes << "\n";
+    } catch (const std::exception& e) {
+        std::cerr << "JournalReplay: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
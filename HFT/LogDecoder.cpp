@@ -0,0 +1,54 @@
+// g++ -std=c++20 -O2 LogDecoder.cpp -o LogDecoder
+// ./LogDecoder log_file.bin [out.txt]    (stdout when no output file is given)
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "BinaryLog.hpp"
+
+/**************************************************************************
+Turns a binary AsyncLogger file (LogOutput::Binary) into the same text the
+logger writes with LogOutput::Text.
+**************************************************************************/
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <binary log> [output file]\n";
+        return 1;
+    }
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+        std::cerr << "Cannot open " << argv[1] << "\n";
+        return 1;
+    }
+    std::ofstream file;
+    if (argc > 2) {
+        file.open(argv[2]);
+        if (!file) {
+            std::cerr << "Cannot open " << argv[2] << "\n";
+            return 1;
+        }
+    }
+    std::ostream& out = (argc > 2) ? file : std::cout;
+
+    try {
+        BinaryLogReader reader(in);
+        uint64_t timestampNs = 0;
+        std::string line;
+        size_t records = 0;
+        while (reader.next(timestampNs, line)) {
+            out << "[" << timestampNs << "]";
+            if (reader.hasSequence()) 
+                out << " #" << reader.sequence();
+            out << " | ";
+            if (reader.hasLevel()) 
+                out << logLevelName(reader.level()) << " | ";
+            out << line;
+            ++records;
+        }
+        std::cerr << "Decoded " << records << " records\n";
+    } catch (const std::exception& e) {
+        std::cerr << "LogDecoder: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
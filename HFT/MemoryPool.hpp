@@ -4,8 +4,24 @@
 #include <iostream>
 #include <vector>
 #include <stack>
+#include <array>
 #include <atomic>
+#include <memory>
+#include <utility>
+#include <type_traits>
+#include <algorithm>
+#include <bit>
 #include <concepts>
+#include <unordered_map>
+#include <tuple>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
 #include <boost/pool/object_pool.hpp>
 
 namespace Const {
@@ -14,6 +30,11 @@ namespace Const {
 #else
     constexpr size_t poolMsgCount = POOL_MSG_COUNT; // Use user-defined bucket count
 #endif
+#ifdef POOL_DEBUG
+    constexpr bool poolDebug = true;  // Slot state checks and leak report, see PoolSlotTracker
+#else
+    constexpr bool poolDebug = false;
+#endif
 };
 
 template <typename T>
@@ -22,24 +43,341 @@ concept MyPool = requires(T pool, typename T::MsgPtr msg) {
     { pool.deallocate(msg) } -> std::same_as<void>;
 };
 
+/**************************************************************************
+Usage counters kept by the pools, inUse counts messages handed out and not
+returned yet. Use highWatermark and exhausted from production runs to size
+capacity (and maxCapacity for pools that may grow).
+**************************************************************************/
+struct PoolStats {
+    size_t capacity = 0;
+    size_t inUse = 0;
+    size_t highWatermark = 0;
+    uint64_t exhausted = 0;   // allocate calls that found the pool empty
+    size_t slabs = 0;         // 1 unless the pool has grown
+};
+
+/**************************************************************************
+Move-only owner of a pooled message, the deleter hands it back to its pool 
+(MemoryPool::destroy) when the handle goes out of scope. release() gives up 
+ownership, e.g. to pass the raw pointer through a queue. With StaticPoolDeleter
+(pool with static storage duration) the handle is a single pointer, PoolDeleter
+also keeps a pointer to the pool for pools that live inside other objects.
+**************************************************************************/
+template <typename Msg, typename Deleter>
+class PoolPtr {
+public:
+    PoolPtr() noexcept = default;
+    explicit PoolPtr(Msg* msg, Deleter deleter = {}) noexcept : deleter_(deleter), msg_(msg) { }
+    PoolPtr(PoolPtr&& other) noexcept : deleter_(other.deleter_), msg_(std::exchange(other.msg_, nullptr)) { }
+    PoolPtr& operator=(PoolPtr&& other) {
+        if (this != &other) {
+            reset();
+            deleter_ = other.deleter_;
+            msg_ = std::exchange(other.msg_, nullptr);
+        }
+        return *this;
+    }
+    PoolPtr(const PoolPtr&) = delete;
+    PoolPtr& operator=(const PoolPtr&) = delete;
+    ~PoolPtr() { reset(); }
+
+    Msg* get() const noexcept { return msg_; }
+    Msg* operator->() const noexcept { return msg_; }
+    Msg& operator*() const noexcept { return *msg_; }
+    explicit operator bool() const noexcept { return msg_ != nullptr; }
+    Msg* release() noexcept { return std::exchange(msg_, nullptr); }
+    void reset() {
+        if (msg_) 
+            deleter_(std::exchange(msg_, nullptr));
+    }
+private:
+    [[no_unique_address]] Deleter deleter_;
+    Msg* msg_ = nullptr;
+};
+
+template <typename P>
+struct PoolDeleter {
+    P* pool = nullptr;
+    void operator()(auto* msg) const { pool->destroy(msg); }
+};
+
+template <auto& Pool>
+struct StaticPoolDeleter {
+    void operator()(auto* msg) const { Pool.destroy(msg); }
+};
+
 /**************************************************************************
 Supported Q types include BoostPool, CustomLockedPool, CustomLockFreePool and
 LockFreeThreadSafePool. Check TestPool.cpp for usage examples.
+
+allocate/deallocate hand out raw slots. create/destroy (and make, returning a
+PoolPtr) also run the constructor and destructor. Free slots of non trivially
+constructible types hold a default constructed Msg (PoolStorage and boost build
+them up front), create() and destroy() keep it that way so both APIs can be
+mixed on one pool. Pools declaring rawSlots (SizeClassPool::Typed) hand out raw
+memory instead. Like new Msg, create() without arguments default-initialises.
 **************************************************************************/
 template <MyPool P, bool ThreadSafe = false>
 class MemoryPool {
 public:
+    using MsgPtr = P::MsgPtr;
+    using Msg = std::remove_pointer_t<MsgPtr>;
+    using Ptr = PoolPtr<Msg, PoolDeleter<MemoryPool>>;
+
     MemoryPool() { }
-    P::MsgPtr allocate() {
+    template <typename... Args>
+    explicit MemoryPool(Args&&... args) : pool_(std::forward<Args>(args)...) { }
+    MsgPtr allocate() {
         return pool_.allocate();
     }
-    void deallocate(P::MsgPtr msg) {
+    void deallocate(MsgPtr msg) {
+        pool_.deallocate(msg);
+    }
+    // nullptr (or the pool's exception) when the pool is exhausted
+    template <typename... Args>
+    MsgPtr create(Args&&... args) {
+        MsgPtr msg = pool_.allocate();
+        if (!msg) 
+            return msg;
+        if constexpr (parked) 
+            msg->~Msg();
+        try {
+            construct(msg, std::forward<Args>(args)...);
+        } catch (...) {
+            if constexpr (parked) 
+                construct(msg);
+            pool_.deallocate(msg);
+            throw;
+        }
+        return msg;
+    }
+    void destroy(MsgPtr msg) {
+        msg->~Msg();
+        if constexpr (parked) 
+            construct(msg);
         pool_.deallocate(msg);
     }
+    template <typename... Args>
+    Ptr make(Args&&... args) {
+        return Ptr(create(std::forward<Args>(args)...), { this });
+    }
+    void prefault() {
+        if constexpr (requires { pool_.prefault(); })
+            pool_.prefault();
+    }
+    PoolStats stats() const {
+        return pool_.stats();
+    }
 private:
+    static constexpr bool parked = !std::is_trivially_default_constructible_v<Msg> && 
+        !requires { requires P::rawSlots; };
+
+    template <typename... Args>
+    static void construct(MsgPtr msg, Args&&... args) {
+        if constexpr (sizeof...(Args) == 0) 
+            ::new (static_cast<void*>(msg)) Msg;
+        else 
+            std::construct_at(msg, std::forward<Args>(args)...);
+    }
+
     P pool_;
 };
 
+// PoolPtr to a msg created on a pool with static storage duration, a single pointer
+template <auto& Pool, typename... Args>
+auto makePooled(Args&&... args) {
+    using Pooled = PoolPtr<typename std::remove_reference_t<decltype(Pool)>::Msg, StaticPoolDeleter<Pool>>;
+    static_assert(sizeof(Pooled) == sizeof(void*), "PoolPtr with a static pool must be a single pointer");
+    return Pooled(Pool.create(std::forward<Args>(args)...));
+}
+
+/**************************************************************************
+Backing memory options for the pool storage. Pages are only faulted in when
+first written, so either set prefault or call prefault() on the pool from the
+thread that will use it: without a NUMA binding the pages land on that thread's
+node. HugeTLB needs reserved huge pages (vm.nr_hugepages) and falls back to 
+transparent huge pages when none are available.
+**************************************************************************/
+struct PoolBacking {
+    enum class Pages { Normal, TransparentHuge, HugeTLB };
+    Pages pages = Pages::Normal;
+    int numaNode = -1;      // -1 keeps the default (first touch) placement
+    bool prefault = false;  // fault every page in on the constructing thread
+};
+
+/**************************************************************************
+Fixed array of Msg in anonymous mmap memory, used by the pools instead of a 
+std::vector<Msg>. Trivial messages are left untouched (the kernel hands out 
+zeroed pages on first write), others are default constructed in place.
+**************************************************************************/
+template <typename Msg>
+class PoolStorage {
+public:
+    static constexpr size_t hugePageSize = 2 << 20;
+
+    explicit PoolStorage(size_t count, const PoolBacking& backing = {})
+            : count_(count) {
+        const size_t bytes = std::max<size_t>(count * sizeof(Msg), 1);
+        PoolBacking::Pages pages = backing.pages;
+        if (pages == PoolBacking::Pages::HugeTLB) {
+            mappedSize_ = roundUp(bytes, hugePageSize);
+            base_ = ::mmap(nullptr, mappedSize_, PROT_READ | PROT_WRITE, 
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (base_ == MAP_FAILED) {
+                std::cerr << "PoolStorage: MAP_HUGETLB failed (" << std::strerror(errno) << 
+                    "), using transparent huge pages\n";
+                pages = PoolBacking::Pages::TransparentHuge;
+            }
+        }
+        if (pages != PoolBacking::Pages::HugeTLB) {
+            mappedSize_ = (pages == PoolBacking::Pages::TransparentHuge) ? roundUp(bytes, hugePageSize) : 
+                roundUp(bytes, ::sysconf(_SC_PAGESIZE));
+            base_ = ::mmap(nullptr, mappedSize_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (base_ == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+            if (pages == PoolBacking::Pages::TransparentHuge) {
+                ::madvise(base_, mappedSize_, MADV_HUGEPAGE);
+            }
+        }
+        if (backing.numaNode >= 0) {
+            bindToNode(backing.numaNode);
+        }
+        if (backing.prefault) {
+            prefault();
+        }
+        if constexpr (!std::is_trivially_default_constructible_v<Msg>) {
+            for (size_t i = 0; i < count_; ++i) {
+                new (data() + i) Msg();
+            }
+        }
+    }
+    ~PoolStorage() {
+        if constexpr (!std::is_trivially_destructible_v<Msg>) {
+            for (size_t i = 0; i < count_; ++i) {
+                data()[i].~Msg();
+            }
+        }
+        ::munmap(base_, mappedSize_);
+    }
+    PoolStorage(const PoolStorage&) = delete;
+    PoolStorage& operator=(const PoolStorage&) = delete;
+
+    // Faults all pages in from the calling thread without changing their contents
+    void prefault() {
+        if (::madvise(base_, mappedSize_, MADV_POPULATE_WRITE) == 0) {
+            return;
+        }
+        const size_t pageSize = ::sysconf(_SC_PAGESIZE); // pre 5.14 kernels, touch each page
+        volatile char* bytes = static_cast<char*>(base_);
+        for (size_t offset = 0; offset < mappedSize_; offset += pageSize) {
+            bytes[offset] = bytes[offset];
+        }
+    }
+    Msg& operator[](size_t index) { return data()[index]; }
+    const Msg& operator[](size_t index) const { return data()[index]; }
+    Msg* data() { return static_cast<Msg*>(base_); }
+    const Msg* data() const { return static_cast<const Msg*>(base_); }
+    size_t size() const { return count_; }
+    bool contains(const Msg* msg) const { return msg >= data() && msg < data() + count_; }
+    // Index of msg, throws for pointers outside the storage or into the middle of a slot
+    size_t slotOf(const Msg* msg) const {
+        const uintptr_t offset = reinterpret_cast<uintptr_t>(msg) - reinterpret_cast<uintptr_t>(data());
+        if (!contains(msg) || offset % sizeof(Msg) != 0) {
+            throw std::invalid_argument("Message does not belong to this pool");
+        }
+        return offset / sizeof(Msg);
+    }
+
+private:
+    static size_t roundUp(size_t value, size_t multiple) {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+    void bindToNode(int node) {
+        unsigned long nodeMask[16] = {};
+        if (node >= static_cast<int>(sizeof(nodeMask) * 8)) {
+            throw std::invalid_argument("PoolStorage: NUMA node out of range");
+        }
+        nodeMask[node / (sizeof(unsigned long) * 8)] |= 1ul << (node % (sizeof(unsigned long) * 8));
+        if (::syscall(SYS_mbind, base_, mappedSize_, MPOL_BIND, nodeMask, sizeof(nodeMask) * 8, 
+                MPOL_MF_MOVE) != 0) {
+            std::cerr << "PoolStorage: mbind to node " << node << " failed (" << std::strerror(errno) << ")\n";
+        }
+    }
+
+    void* base_{ nullptr };
+    size_t mappedSize_{ 0 };
+    size_t count_{ 0 };
+};
+
+/**************************************************************************
+Debug bookkeeping for the pools, compiled in with -DPOOL_DEBUG. Each slot has
+a bit that is set while its msg is handed out: allocating a slot whose bit is 
+set means the free list is corrupted, freeing a slot whose bit is clear is a 
+double free. Pools map the freed pointer to its slot with PoolStorage::slotOf
+first, so foreign and interior pointers are rejected before they reach the 
+free list. Slots still set when the pool is destroyed are reported as leaks.
+
+Without POOL_DEBUG the pools hold an empty [[no_unique_address]] tracker with
+no-op members, and the slot lookups feeding it sit behind if constexpr 
+(enabled), so release builds pay nothing.
+**************************************************************************/
+template <bool Enabled = Const::poolDebug>
+class PoolSlotTracker {
+public:
+    static constexpr bool enabled = false;
+    explicit PoolSlotTracker(size_t = 0) { }
+    void onAllocate(size_t) { }
+    void onDeallocate(size_t) { }
+    size_t live() const { return 0; }
+    void reportLeaks(const char*) const { }
+};
+
+template <>
+class PoolSlotTracker<true> {
+public:
+    static constexpr bool enabled = true;
+    explicit PoolSlotTracker(size_t maxSlots = 0) 
+        : words_((maxSlots + 63) / 64), bits_(new std::atomic<uint64_t>[words_]()) { }
+
+    void onAllocate(size_t slot) {
+        const uint64_t bit = uint64_t(1) << (slot % 64);
+        if (bits_[slot / 64].fetch_or(bit, std::memory_order_acq_rel) & bit) {
+            throw std::logic_error("Pool slot " + std::to_string(slot) + 
+                " handed out while in use, the free list is corrupted");
+        }
+    }
+    void onDeallocate(size_t slot) {
+        const uint64_t bit = uint64_t(1) << (slot % 64);
+        if (!(bits_[slot / 64].fetch_and(~bit, std::memory_order_acq_rel) & bit)) {
+            throw std::invalid_argument("Double free of pool slot " + std::to_string(slot));
+        }
+    }
+    size_t live() const {
+        size_t count = 0;
+        for (size_t w = 0; w < words_; ++w) 
+            count += std::popcount(bits_[w].load(std::memory_order_relaxed));
+        return count;
+    }
+    // Lists the first leaked slots on std::cerr, nothing when all msgs came back
+    void reportLeaks(const char* poolType) const {
+        const size_t leaked = live();
+        if (leaked == 0) 
+            return;
+        std::cerr << "PoolDebug: " << poolType << " destroyed with " << leaked << " msgs not returned, slots:";
+        size_t listed = 0;
+        for (size_t w = 0; w < words_ && listed < 16; ++w) {
+            uint64_t bits = bits_[w].load(std::memory_order_relaxed);
+            for (; bits && listed < 16; bits &= bits - 1, ++listed)
+                std::cerr << " " << (w * 64 + std::countr_zero(bits));
+        }
+        std::cerr << (leaked > listed ? " ...\n" : "\n");
+    }
+private:
+    size_t words_;
+    std::unique_ptr<std::atomic<uint64_t>[]> bits_;
+};
+
 /**************************************************************************/
 template <class Msg, bool ThreadSafe = false> 
 class BoostPool {
@@ -69,174 +407,933 @@ private:
     std::mutex mtx_; // Only used if ThreadSafe is true
 };
 
-/**************************************************************************/
+/**************************************************************************
+maxCapacity > capacity lets the pool grow by slabs of capacity messages up to
+maxCapacity instead of throwing, existing messages never move.
+**************************************************************************/
 template <class Msg, bool ThreadSafe = true> 
 class CustomLockedPool {
 public:
     using MsgPtr = Msg*;
-    CustomLockedPool()
-            : pool_(Const::poolMsgCount) {
+    explicit CustomLockedPool(size_t capacity = Const::poolMsgCount, const PoolBacking& backing = {}, 
+            size_t maxCapacity = 0)
+            : backing_(backing)
+            , slabSize_(capacity)
+            , maxCapacity_(std::max(capacity, maxCapacity))
+            , tracker_(maxCapacity_) {
         std::cout << "CustomLockedPool initialized for type: " << typeid(Msg).name() << "\n";
-        for (size_t i = 0; i < pool_.size(); ++i) {
-            freeMsgs_.push(&pool_[i]);
-        }
+        addSlab(capacity);
+    }
+    ~CustomLockedPool() {
+        if constexpr (Tracker::enabled) 
+            tracker_.reportLeaks(typeid(*this).name());
     }
     MsgPtr allocate() {
         if constexpr (ThreadSafe) {
             std::lock_guard<std::mutex> lock(mutex_);
-            if (freeMsgs_.empty()) {
-                throw std::runtime_error("No free messages available in the pool");
-            }
-            MsgPtr msg = freeMsgs_.top(); freeMsgs_.pop();
-            return msg;
+            return allocateUnlocked();
         }
-        if (freeMsgs_.empty()) {
-            throw std::runtime_error("No free messages available in the pool");
-        }
-        MsgPtr msg = freeMsgs_.top(); freeMsgs_.pop();
-        return msg;
+        return allocateUnlocked();
     }
     void deallocate(MsgPtr msg) {
         if constexpr (ThreadSafe) {
             std::lock_guard<std::mutex> lock(mutex_);
-            freeMsgs_.push(msg);
+            deallocateUnlocked(msg);
         }
         else {
-            freeMsgs_.push(msg);
+            deallocateUnlocked(msg);
+        }
+    }
+    // Fault the storage in from the calling (consuming) thread, see PoolBacking
+    void prefault() { 
+        for (auto& slab : slabs_) slab->prefault();
+    }
+    PoolStats stats() const {
+        if constexpr (ThreadSafe) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return stats_;
         }
+        return stats_;
     }
 private:
-    std::vector<Msg> pool_;
+    MsgPtr allocateUnlocked() {
+        if (freeMsgs_.empty()) {
+            if (stats_.capacity >= maxCapacity_) {
+                ++stats_.exhausted;
+                throw std::runtime_error("No free messages available in the pool");
+            }
+            addSlab(std::min(slabSize_, maxCapacity_ - stats_.capacity));
+        }
+        MsgPtr msg = freeMsgs_.top(); freeMsgs_.pop();
+        if constexpr (Tracker::enabled) 
+            tracker_.onAllocate(slotOf(msg));
+        if (++stats_.inUse > stats_.highWatermark) 
+            stats_.highWatermark = stats_.inUse;
+        return msg;
+    }
+    void deallocateUnlocked(MsgPtr msg) {
+        if constexpr (Tracker::enabled) 
+            tracker_.onDeallocate(slotOf(msg));
+        freeMsgs_.push(msg);
+        --stats_.inUse;
+    }
+    // Every slab but the last holds slabSize_ msgs, so slot = slab * slabSize_ + offset
+    size_t slotOf(MsgPtr msg) const {
+        for (size_t s = 0; s < slabs_.size(); ++s) {
+            if (slabs_[s]->contains(msg)) 
+                return s * slabSize_ + slabs_[s]->slotOf(msg);
+        }
+        throw std::invalid_argument("Message does not belong to this pool");
+    }
+    void addSlab(size_t count) {
+        auto& slab = slabs_.emplace_back(std::make_unique<PoolStorage<Msg>>(count, backing_));
+        for (size_t i = 0; i < slab->size(); ++i) {
+            freeMsgs_.push(&(*slab)[i]);
+        }
+        stats_.capacity += count;
+        ++stats_.slabs;
+    }
+
+    const PoolBacking backing_;
+    const size_t slabSize_;
+    const size_t maxCapacity_;
+    std::vector<std::unique_ptr<PoolStorage<Msg>>> slabs_;
     std::stack<MsgPtr> freeMsgs_;
-    std::mutex mutex_;  // only used when ThreadSafe = true
+    PoolStats stats_;
+    mutable std::mutex mutex_;  // only used when ThreadSafe = true
+    using Tracker = PoolSlotTracker<>;
+    [[no_unique_address]] Tracker tracker_;
 };
 
-/**************************************************************************/
+/**************************************************************************
+Head of the CustomLockFreePool and LockFreeThreadSafePool free stacks: a free
+list index plus a tag
+that changes on every update, so a CAS fails if the head was popped and pushed
+back in between (ABA). TaggedHead<false> packs a 32 bit index and a 32 bit tag
+into one word. TaggedHead<true> keeps a 64 bit index and a 64 bit tag in 16
+bytes updated with cmpxchg16b, for pools beyond 4G entries or when a 32 bit tag
+could wrap while a thread is preempted mid-pop.
+**************************************************************************/
+template <bool Wide>
+class TaggedHead;
+
+template <>
+class TaggedHead<false> {
+public:
+    using Value = size_t;
+    static constexpr size_t EMPTY = 0xFFFFFFFF; // end of the free list, the all ones index
+
+    static size_t index(Value head) { 
+        return head & EMPTY; 
+    }
+    void store(size_t index) { 
+        head_.store(index, std::memory_order_relaxed); 
+    }
+    Value load() const { 
+        return head_.load(std::memory_order_acquire); 
+    }
+    // On failure expected is refreshed with the current head
+    bool compareExchange(Value& expected, size_t newIndex) {
+        const Value tag = (expected >> TAG_SHIFT) + 1;
+        return head_.compare_exchange_weak(expected, (tag << TAG_SHIFT) | (newIndex & EMPTY),
+                    std::memory_order_acq_rel, std::memory_order_acquire);
+    }
+private:
+    static constexpr size_t TAG_SHIFT = 32;
+    std::atomic<size_t> head_; // lower 32 bits: index, upper 32 bits: tag
+};
+
+template <>
+class TaggedHead<true> {
+public:
+    struct alignas(16) Value {
+        uint64_t index;
+        uint64_t tag;
+    };
+    static constexpr size_t EMPTY = UINT64_MAX;
+
+    static size_t index(const Value& head) { 
+        return head.index; 
+    }
+    void store(size_t index) { 
+        head_ = { index, 0 }; 
+    }
+    // cmpxchg16b is the only atomic 16 byte read, a CAS of the value with itself
+    Value load() { 
+        Value expected{ 0, 0 };
+        cas(expected, expected);
+        return expected;
+    }
+    bool compareExchange(Value& expected, size_t newIndex) {
+        return cas(expected, { newIndex, expected.tag + 1 });
+    }
+private:
+    bool cas(Value& expected, Value desired) {
+#if defined(__x86_64__) && !defined(__SANITIZE_THREAD__)
+        bool swapped;
+        __asm__ __volatile__("lock cmpxchg16b %1"
+            : "=@ccz"(swapped), "+m"(head_), "+a"(expected.index), "+d"(expected.tag)
+            : "b"(desired.index), "c"(desired.tag)
+            : "memory");
+        return swapped;
+#else   // libatomic (-latomic), visible to TSAN
+        return __atomic_compare_exchange(&head_, &expected, &desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif
+    }
+    Value head_;
+};
+
+/**************************************************************************
+Fixed capacity, it does not grow. The free list is a stack of slot indices
+(next_ holds the index below each free slot) under a TaggedHead<false>: a pop
+that raced with a pop and push back of the same slot fails its CAS instead of
+handing the msg out twice (ABA). Up to 4G msgs.
+**************************************************************************/
 template <class Msg, bool ThreadSafe = true> 
 class CustomLockFreePool {
 public:
     using MsgPtr = Msg*;
-    CustomLockFreePool()
-            : pool_(Const::poolMsgCount)
-            , freeMsgs_(Const::poolMsgCount)
-            , head_(Const::poolMsgCount - 1) {
+    explicit CustomLockFreePool(size_t capacity = Const::poolMsgCount, const PoolBacking& backing = {})
+            : pool_(checkedCapacity(capacity), backing)
+            , next_(new std::atomic<size_t>[capacity])
+            , tracker_(capacity) {
         std::cout << "CustomLockFreePool initialized for type: " << 
             typeid(Msg).name() << "\n";
         if constexpr (!ThreadSafe)
-            std::cout << "Warning: CustomLockFreePool is thread-safe always\n";
-        for (size_t i = 0; i < pool_.size(); ++i) {
-            freeMsgs_[i] = &pool_[i];
+            std::cout << "Warning: CustomLockFreePool is lock free, thread-safe always\n";
+        for (size_t i = 0; i < capacity; ++i) {
+            next_[i].store(i + 1 < capacity ? i + 1 : EMPTY, std::memory_order_relaxed);
         }
+        head_.store(capacity > 0 ? 0 : EMPTY);
+    }
+    ~CustomLockFreePool() {
+        if constexpr (Tracker::enabled) 
+            tracker_.reportLeaks(typeid(*this).name());
     }
     MsgPtr allocate() {
-        int64_t currentHead = head_.load(std::memory_order_acquire);
-        while (currentHead >= 0) {
-            MsgPtr msg = freeMsgs_[static_cast<size_t>(currentHead)];
-            // try to pop the head atomically
-            if (head_.compare_exchange_weak(currentHead, currentHead - 1,
-                    std::memory_order_acquire, std::memory_order_relaxed)) {
-                return msg;
+        auto oldHead = head_.load();
+        while (true) {
+            const size_t index = Head::index(oldHead);
+            if (index == EMPTY) {
+                exhausted_.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            // next_ may be stale if the slot was popped meanwhile, the tag then fails the CAS
+            if (head_.compareExchange(oldHead, next_[index].load(std::memory_order_relaxed))) {
+                updateHighWatermark(inUse_.fetch_add(1, std::memory_order_relaxed) + 1);
+                if constexpr (Tracker::enabled) 
+                    tracker_.onAllocate(index);
+                return &pool_[index];
             }
-            // currentHead updated by compare_exchange_weak, loop again
         }
-        return nullptr;
     }
     void deallocate(MsgPtr msg) {
         if (msg == nullptr) {
             throw std::runtime_error("Cannot deallocate a null message");
         }
-        int64_t currentHead = head_.load(std::memory_order_relaxed);
-        while (true) {
-            int64_t nextHead = currentHead + 1;
-            if (nextHead >= static_cast<int64_t>(Const::poolMsgCount)) {
-                throw std::runtime_error("Pool overflow on deallocate");
-            }
-            freeMsgs_[static_cast<size_t>(nextHead)] = msg;
-            if (head_.compare_exchange_weak(currentHead, nextHead,
-                    std::memory_order_release, std::memory_order_relaxed)) {
-                return;
-            }
-            // currentHead updated by compare_exchange_weak, retry
-        }
+        const size_t index = pool_.slotOf(msg);
+        if constexpr (Tracker::enabled) 
+            tracker_.onDeallocate(index);
+        inUse_.fetch_sub(1, std::memory_order_relaxed);
+        // the link is written before the CAS publishes the slot, nobody can pop it yet
+        auto oldHead = head_.load();
+        do {
+            next_[index].store(Head::index(oldHead), std::memory_order_relaxed);
+        } while (!head_.compareExchange(oldHead, index));
+    }
+    void prefault() { pool_.prefault(); }
+    PoolStats stats() const {
+        return { pool_.size(), inUse_.load(std::memory_order_relaxed), highWatermark_.load(std::memory_order_relaxed), 
+            exhausted_.load(std::memory_order_relaxed), 1 };
     }
 private:
-    std::vector<Msg> pool_;
-    std::vector<MsgPtr> freeMsgs_;
-    alignas(64) std::atomic<int64_t> head_;
+    using Head = TaggedHead<false>;
+    static constexpr size_t EMPTY = Head::EMPTY;
+
+    static size_t checkedCapacity(size_t capacity) {
+        if (capacity >= EMPTY) {
+            throw std::invalid_argument("CustomLockFreePool capacity must be below 4G msgs");
+        }
+        return capacity;
+    }
+    void updateHighWatermark(size_t inUse) {
+        size_t current = highWatermark_.load(std::memory_order_relaxed);
+        while (inUse > current && 
+            !highWatermark_.compare_exchange_weak(current, inUse, std::memory_order_relaxed)) { }
+    }
+
+    PoolStorage<Msg> pool_;
+    std::unique_ptr<std::atomic<size_t>[]> next_;  // free list links by slot index
+    alignas(64) Head head_;
+    alignas(64) std::atomic<size_t> inUse_{ 0 };
+    std::atomic<size_t> highWatermark_{ 0 };
+    std::atomic<uint64_t> exhausted_{ 0 };
+    using Tracker = PoolSlotTracker<>;
+    [[no_unique_address]] Tracker tracker_;
 };
 
-/**************************************************************************/
-template <typename Msg, bool ThreadSafe = true>
+/**************************************************************************
+MagazineSize > 0 adds a per-thread cache (magazine) in front of the global
+free stack. allocate/deallocate then work on thread local memory and only 
+touch head_ once every MagazineSize operations, popping or pushing a whole
+chain of MagazineSize messages with a single CAS. Messages cached by a thread
+are not visible to others until it flushes them (when its magazine holds
+2 * MagazineSize messages, or at thread exit), so size the pool with some
+headroom. Magazines are shared between the pool and the thread so neither
+side outliving the other leaves a dangling pointer. Messages parked in 
+magazines count as inUse in stats().
+
+Storage is a chain of slabs, slab s owns the indices [s << slabShift_, ...).
+With maxCapacity > capacity an allocate that finds the pool empty adds a slab
+of capacity messages (up to maxCapacity) instead of returning nullptr, 
+existing messages never move.
+
+WideHead = true switches to TaggedHead<true> (64 bit index and tag).
+**************************************************************************/
+template <typename Msg, bool ThreadSafe = true, size_t MagazineSize = 0, bool WideHead = false>
 class LockFreeThreadSafePool {
 public:
     using MsgPtr = Msg*;
-    LockFreeThreadSafePool() 
-            : pool_(Const::poolMsgCount)
-            , nextFree_(Const::poolMsgCount) {
-        for (size_t i = 0; i < Const::poolMsgCount; ++i) {
-            nextFree_[i] = i - 1;
+    explicit LockFreeThreadSafePool(size_t capacity = Const::poolMsgCount, const PoolBacking& backing = {}, 
+            size_t maxCapacity = 0) 
+            : backing_(backing)
+            , slabShift_(std::bit_width(std::max<size_t>(capacity, 2) - 1))
+            , slabSize_(capacity)
+            , maxCapacity_(std::max(capacity, maxCapacity)) {
+        const size_t maxSlabs = capacity ? (maxCapacity_ + capacity - 1) / capacity : 0;
+        if (capacity == 0 || maxSlabs > MAX_SLABS || slabShift_ + std::bit_width(maxSlabs) > INDEX_BITS) {
+            throw std::invalid_argument("LockFreeThreadSafePool capacity exceeds the head index width "
+                "(use WideHead beyond 4G msgs) or 64 slabs");
+        }
+        if constexpr (Tracker::enabled) 
+            tracker_ = Tracker(maxSlabs << slabShift_);
+        const size_t top = addSlab(capacity);
+        head_.store(top);
+    }
+    ~LockFreeThreadSafePool() {
+        if constexpr (Tracker::enabled) 
+            tracker_.reportLeaks(typeid(*this).name());
+        if constexpr (MagazineSize > 0) {
+            std::lock_guard<std::mutex> lock(magazinesMutex_);
+            for (auto& magazine : magazines_) {
+                // waits for a thread flushing it right now, later flushes see no owner
+                std::lock_guard<std::mutex> detach(magazine->ownerMutex);
+                magazine->owner = nullptr;
+            }
+        }
+        for (auto& slab : slabs_) {
+            delete slab.load(std::memory_order_relaxed);
         }
-        head_.store(pack(Const::poolMsgCount - 1, 0), std::memory_order_relaxed);
     }
 
     MsgPtr allocate() {
-        size_t oldHead = head_.load(std::memory_order_acquire);
+        if constexpr (MagazineSize > 0) {
+            Magazine& magazine = threadMagazine();
+            if (magazine.count == 0) [[unlikely]] {
+                magazine.count = popChain(magazine.items.data(), MagazineSize);
+                if (magazine.count == 0) {
+                    return nullptr;
+                }
+            }
+            return tracked(magazine.items[--magazine.count]);
+        }
+        MsgPtr msg;
+        return popChain(&msg, 1) ? tracked(msg) : nullptr; // msg may hold a stale pick from a failed CAS
+    }
+
+    void deallocate(MsgPtr msg) {
+        if (msg == nullptr) {
+            throw std::runtime_error("Cannot deallocate nullptr");
+        }
+        if constexpr (Tracker::enabled) 
+            tracker_.onDeallocate(indexOf(msg));
+        if constexpr (MagazineSize > 0) {
+            Magazine& magazine = threadMagazine();
+            if (magazine.count == magazine.items.size()) [[unlikely]] {
+                // hand the older half back, keep the recently freed (cache warm) half
+                pushChain(magazine.items.data(), MagazineSize);
+                std::copy(magazine.items.begin() + MagazineSize, magazine.items.end(), magazine.items.begin());
+                magazine.count -= MagazineSize;
+            }
+            magazine.items[magazine.count++] = msg;
+            return;
+        }
+        pushChain(&msg, 1);
+    }
+    // Fault the storage in from the calling (consuming) thread, see PoolBacking
+    void prefault() {
+        for (size_t s = 0; s < numSlabs_.load(std::memory_order_acquire); ++s) {
+            slabs_[s].load(std::memory_order_relaxed)->msgs.prefault();
+        }
+    }
+    PoolStats stats() const {
+        return { capacity_.load(std::memory_order_relaxed), inUse_.load(std::memory_order_relaxed),
+            highWatermark_.load(std::memory_order_relaxed), exhausted_.load(std::memory_order_relaxed),
+            numSlabs_.load(std::memory_order_relaxed) };
+    }
+    bool contains(const Msg* msg) const {
+        for (size_t s = 0; s < numSlabs_.load(std::memory_order_acquire); ++s) {
+            if (slabs_[s].load(std::memory_order_relaxed)->msgs.contains(msg))
+                return true;
+        }
+        return false;
+    }
+private:
+    struct Slab {
+        Slab(size_t count, const PoolBacking& backing) 
+            : msgs(count, backing), nextFree(new std::atomic<size_t>[count]) { }
+        PoolStorage<Msg> msgs;
+        // Read by poppers racing with the owner of a just popped msg, hence atomic (relaxed)
+        std::unique_ptr<std::atomic<size_t>[]> nextFree;
+    };
+
+    Slab& slabOf(size_t index) const {
+        return *slabs_[index >> slabShift_].load(std::memory_order_relaxed); // published before its indices
+    }
+    MsgPtr msgAt(size_t index) const {
+        return &slabOf(index).msgs[index & slabMask()];
+    }
+    std::atomic<size_t>& nextOf(size_t index) const {
+        return slabOf(index).nextFree[index & slabMask()];
+    }
+    size_t slabMask() const { 
+        return (size_t(1) << slabShift_) - 1; 
+    }
+
+    // Pops up to maxCount messages with one CAS, growing the pool if it is empty
+    size_t popChain(MsgPtr* out, size_t maxCount) {
         while (true) {
-            size_t index;
-            uint32_t tag;
-            unpack(oldHead, index, tag);
+            if (size_t count = tryPopChain(out, maxCount)) {
+                addInUse(count);
+                return count;
+            }
+            if (!grow()) {
+                exhausted_.fetch_add(1, std::memory_order_relaxed);
+                return 0;
+            }
+        }
+    }
 
-            if (index == -1) {
-                return nullptr;
+    // The tag changes on every head_ update, so a successful CAS proves the 
+    // walked chain was not modified.
+    size_t tryPopChain(MsgPtr* out, size_t maxCount) {
+        auto oldHead = head_.load();
+        while (true) {
+            size_t index = Head::index(oldHead);
+            size_t count = 0;
+            while (count < maxCount && index != EMPTY) {
+                out[count++] = msgAt(index);
+                index = nextOf(index).load(std::memory_order_relaxed);
             }
+            if (count == 0) {
+                return 0;
+            }
+            if (head_.compareExchange(oldHead, index)) {
+                return count;
+            }
+        }
+    }
+
+    // Links msgs[0] -> msgs[1] -> ... -> msgs[count - 1] -> head and publishes with one CAS
+    void pushChain(const MsgPtr* msgs, size_t count) {
+        const size_t first = indexOf(msgs[0]);
+        size_t last = first;
+        for (size_t i = 1; i < count; ++i) {
+            const size_t index = indexOf(msgs[i]);
+            nextOf(last).store(index, std::memory_order_relaxed);
+            last = index;
+        }
+        pushIndexChain(first, last);
+        inUse_.fetch_sub(count, std::memory_order_relaxed);
+    }
 
-            size_t nextIndex = nextFree_[index];
+    void pushIndexChain(size_t first, size_t last) {
+        auto oldHead = head_.load();
+        do {
+            nextOf(last).store(Head::index(oldHead), std::memory_order_relaxed);
+        } while (!head_.compareExchange(oldHead, first));
+    }
 
-            size_t newHead = pack(nextIndex, tag + 1);
+    // Adds a slab when the pool is empty and may still grow, false when it may not
+    bool grow() {
+        if (capacity_.load(std::memory_order_relaxed) >= maxCapacity_) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(growMutex_);
+        if (Head::index(head_.load()) != EMPTY) {
+            return true; // another thread grew the pool or messages came back meanwhile
+        }
+        const size_t capacity = capacity_.load(std::memory_order_relaxed);
+        if (capacity >= maxCapacity_) {
+            return false;
+        }
+        const size_t top = addSlab(std::min(slabSize_, maxCapacity_ - capacity));
+        pushIndexChain(top, (numSlabs_.load(std::memory_order_relaxed) - 1) << slabShift_);
+        return true;
+    }
 
-            if (head_.compare_exchange_weak(oldHead, newHead,
-                        std::memory_order_acq_rel, std::memory_order_acquire)) {
-                return &pool_[index];
+    // Creates the next slab with its messages chained top down, returns the top index
+    size_t addSlab(size_t count) {
+        const size_t slab = numSlabs_.load(std::memory_order_relaxed);
+        const size_t base = slab << slabShift_;
+        Slab* newSlab = new Slab(count, backing_);
+        for (size_t i = 0; i < count; ++i) {
+            newSlab->nextFree[i].store((i == 0) ? EMPTY : base + i - 1, std::memory_order_relaxed);
+        }
+        slabs_[slab].store(newSlab, std::memory_order_release);
+        numSlabs_.store(slab + 1, std::memory_order_release);
+        capacity_.fetch_add(count, std::memory_order_relaxed);
+        return base + count - 1;
+    }
+
+    MsgPtr tracked(MsgPtr msg) {
+        if constexpr (Tracker::enabled) 
+            tracker_.onAllocate(indexOf(msg));
+        return msg;
+    }
+
+    void addInUse(size_t count) {
+        const size_t inUse = inUse_.fetch_add(count, std::memory_order_relaxed) + count;
+        size_t current = highWatermark_.load(std::memory_order_relaxed);
+        while (inUse > current && 
+            !highWatermark_.compare_exchange_weak(current, inUse, std::memory_order_relaxed)) { }
+    }
+
+    size_t indexOf(MsgPtr msg) const {
+        const size_t numSlabs = numSlabs_.load(std::memory_order_acquire);
+        for (size_t s = 0; s < numSlabs; ++s) {
+            const Slab& slab = *slabs_[s].load(std::memory_order_relaxed);
+            if (slab.msgs.contains(msg)) {
+                if constexpr (Tracker::enabled) 
+                    return (s << slabShift_) + slab.msgs.slotOf(msg); // also rejects interior pointers
+                return (s << slabShift_) + static_cast<size_t>(msg - slab.msgs.data());
             }
-            // else retry with updated oldHead
         }
+        throw std::invalid_argument("Message does not belong to this pool");
+    }
+
+    struct Magazine {
+        std::mutex ownerMutex;                      // held by the pool detaching and the thread flushing
+        LockFreeThreadSafePool* owner = nullptr;    // under ownerMutex
+        size_t count = 0;
+        std::array<MsgPtr, 2 * (MagazineSize ? MagazineSize : 1)> items;
+    };
+    // Per thread magazines of every pool instance of this type, flushed back to 
+    // their pool (if it is still alive) when the thread exits. The flush holds the
+    // magazine's ownerMutex so the pool cannot free its slabs under pushChain
+    struct ThreadMagazines {
+        uint64_t lastId = 0;
+        Magazine* last = nullptr;
+        std::unordered_map<uint64_t, std::shared_ptr<Magazine>> byPool;
+        ~ThreadMagazines() {
+            for (auto& [id, magazine] : byPool) {
+                std::lock_guard<std::mutex> lock(magazine->ownerMutex);
+                if (magazine->owner && magazine->count > 0) {
+                    magazine->owner->pushChain(magazine->items.data(), magazine->count);
+                }
+            }
+        }
+    };
+    inline Magazine& threadMagazine() {
+        thread_local ThreadMagazines magazines;
+        if (magazines.lastId == id_) [[likely]] {
+            return *magazines.last;
+        }
+        auto& magazine = magazines.byPool[id_];
+        if (!magazine) {
+            magazine = std::make_shared<Magazine>();
+            magazine->owner = this; // published to the pool under magazinesMutex_
+            std::lock_guard<std::mutex> lock(magazinesMutex_);
+            magazines_.push_back(magazine);
+        }
+        magazines.lastId = id_;
+        magazines.last = magazine.get();
+        return *magazine;
+    }
+
+    using Head = TaggedHead<WideHead>;
+    static constexpr size_t EMPTY = Head::EMPTY;
+    static constexpr size_t INDEX_BITS = std::bit_width(EMPTY); // EMPTY itself is never a valid index
+    static constexpr size_t MAX_SLABS = 64;
+
+    const PoolBacking backing_;
+    const size_t slabShift_;
+    const size_t slabSize_;
+    const size_t maxCapacity_;
+    std::array<std::atomic<Slab*>, MAX_SLABS> slabs_{};
+    std::atomic<size_t> numSlabs_{ 0 };
+    std::atomic<size_t> capacity_{ 0 };
+    std::mutex growMutex_;
+    alignas(64) Head head_;
+    alignas(64) std::atomic<size_t> inUse_{ 0 };
+    std::atomic<size_t> highWatermark_{ 0 };
+    std::atomic<uint64_t> exhausted_{ 0 };
+    alignas(64) std::mutex magazinesMutex_; // only used when MagazineSize > 0
+    std::vector<std::shared_ptr<Magazine>> magazines_;
+    using Tracker = PoolSlotTracker<>;
+    [[no_unique_address]] Tracker tracker_;
+    const uint64_t id_ = nextId_.fetch_add(1, std::memory_order_relaxed);
+    inline static std::atomic<uint64_t> nextId_{ 1 };
+
+};
+
+/**************************************************************************
+Slab allocator for mixed message types: one LockFreeThreadSafePool of raw
+blocks per size class (ascending ClassSizes), so every class has its own lock
+free free list and its own slabs. allocate(bytes) picks the smallest class 
+that fits at runtime, Typed<T> resolves the class at compile time and satisfies
+MyPool, so MemoryPool<SizeClassPool<...>::Typed<T>> works like a pool of T
+while sharing memory with other message types. Blocks are aligned to the 
+lowest set bit of their size, capped at alignof(std::max_align_t).
+**************************************************************************/
+template <size_t... ClassSizes>
+class SizeClassPool {
+    static constexpr std::array<size_t, sizeof...(ClassSizes)> sizes{ ClassSizes... };
+    static_assert(sizeof...(ClassSizes) > 0 && std::is_sorted(sizes.begin(), sizes.end()) && sizes[0] > 0,
+        "Size classes must be positive and ascending");
+
+    template <size_t Size>
+    struct alignas(std::min(Size & (~Size + 1), alignof(std::max_align_t))) Block {
+        std::byte bytes[Size];
+    };
+    template <size_t Size>
+    using ClassPool = LockFreeThreadSafePool<Block<Size>, true>;
+
+public:
+    static constexpr size_t NumClasses = sizeof...(ClassSizes);
+    static constexpr size_t MaxSize = sizes.back();
+
+    explicit SizeClassPool(size_t blocksPerClass = Const::poolMsgCount, const PoolBacking& backing = {}, 
+            size_t maxBlocksPerClass = 0)
+            : pools_{ std::make_unique<ClassPool<ClassSizes>>(blocksPerClass, backing, maxBlocksPerClass)... } {
+        std::cout << "SizeClassPool initialized with " << NumClasses << " classes up to " << MaxSize << " bytes\n";
+    }
+
+    // Smallest class holding bytes, NumClasses when none does
+    static constexpr size_t classOf(size_t bytes) {
+        return static_cast<size_t>(std::lower_bound(sizes.begin(), sizes.end(), bytes) - sizes.begin());
+    }
+    static constexpr size_t classSize(size_t cls) { 
+        return sizes[cls]; 
+    }
+
+    // nullptr when bytes exceeds MaxSize or the class is exhausted
+    void* allocate(size_t bytes) {
+        void* block = nullptr;
+        visit(classOf(bytes), [&](auto& pool) { block = pool.allocate(); });
+        return block;
+    }
+    void deallocate(void* ptr, size_t bytes) {
+        visit(classOf(bytes), [&](auto& pool) { pool.deallocate(blockPtr(pool, ptr)); });
+    }
+    // Without the size the owning class is found by address, one range check per class slab
+    void deallocate(void* ptr) {
+        bool found = false;
+        std::apply([&](auto&... pools) {
+            ((!found && pools->contains(blockPtr(*pools, ptr)) && 
+                (pools->deallocate(blockPtr(*pools, ptr)), found = true)), ...);
+        }, pools_);
+        if (!found) {
+            throw std::invalid_argument("SizeClassPool: pointer does not belong to the pool");
+        }
+    }
+    template <size_t Class>
+    void* allocateClass() {
+        return std::get<Class>(pools_)->allocate();
+    }
+    template <size_t Class>
+    void deallocateClass(void* ptr) {
+        std::get<Class>(pools_)->deallocate(static_cast<Block<sizes[Class]>*>(ptr));
+    }
+    PoolStats stats(size_t cls) const {
+        PoolStats stats{};
+        visit(cls, [&](const auto& pool) { stats = pool.stats(); });
+        return stats;
+    }
+
+    // MyPool view handing out T sized blocks, free slots are raw memory
+    template <typename T>
+    class Typed {
+    public:
+        using MsgPtr = T*;
+        static constexpr bool rawSlots = true;
+        static constexpr size_t Class = classOf(sizeof(T));
+        static_assert(Class < NumClasses, "Type does not fit the largest size class");
+        static_assert(alignof(T) <= alignof(Block<sizes[Class < NumClasses ? Class : 0]>), 
+            "Type is over-aligned for its size class");
+
+        explicit Typed(SizeClassPool& pool) : pool_(pool) { }
+        MsgPtr allocate() { 
+            return static_cast<MsgPtr>(pool_.template allocateClass<Class>()); 
+        }
+        void deallocate(MsgPtr msg) { 
+            pool_.template deallocateClass<Class>(msg); 
+        }
+        PoolStats stats() const { 
+            return pool_.stats(Class); 
+        }
+    private:
+        SizeClassPool& pool_;
+    };
+
+private:
+    template <typename Self, typename F>
+    static void visitImpl(Self& self, size_t cls, F&& f) {
+        [&]<size_t... I>(std::index_sequence<I...>) {
+            ((I == cls ? (f(*std::get<I>(self.pools_)), true) : false) || ...);
+        }(std::make_index_sequence<NumClasses>{});
+    }
+    template <typename F>
+    void visit(size_t cls, F&& f) { visitImpl(*this, cls, std::forward<F>(f)); }
+    template <typename F>
+    void visit(size_t cls, F&& f) const { visitImpl(*this, cls, std::forward<F>(f)); }
+
+    template <typename Pool>
+    static auto blockPtr(const Pool&, void* ptr) {
+        return static_cast<typename Pool::MsgPtr>(ptr);
+    }
+
+    std::tuple<std::unique_ptr<ClassPool<ClassSizes>>...> pools_; // pools are not movable
+};
+
+// Quarter power-of-two spacing, at most 25% (16 bytes below 64) internal fragmentation
+using DefaultSizeClassPool = SizeClassPool<16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 
+    320, 384, 448, 512>;
+
+/**************************************************************************
+Pool for the producer-allocates / consumer-frees pattern. Every allocating
+thread owns a heap (its own slab and a plain free list, no atomics on the
+allocate path). A free from the owner goes straight back to that list, a free
+from any other thread is pushed onto the owner heap's lock free remote stack.
+The owner takes the whole remote stack with one exchange when its local list
+runs dry, so the only cache line crossing threads is the remote stack head and 
+there is no ABA (nobody pops single entries). 
+
+Up to MaxOwners threads can own a heap at a time. A heap is released when its
+thread exits and adopted (with its free msgs) by the next new allocating thread.
+Capacity is per heap and fixed. stats() counts msgs waiting on a remote stack as
+in use until the owner drains them.
+
+All heaps are ranges of one storage reserved up front (MaxOwners x capacity), so
+a remote free finds its owner by dividing the slot index, no search. The
+storage is raw, a heap constructs its msgs when first claimed: pages of heaps
+never claimed are not touched unless the backing prefaults.
+**************************************************************************/
+template <typename Msg, size_t MaxOwners = 4>
+class RemoteFreePool {
+public:
+    using MsgPtr = Msg*;
+    explicit RemoteFreePool(size_t capacityPerOwner = Const::poolMsgCount, const PoolBacking& backing = {})
+            : capacityPerOwner_(capacityPerOwner)
+            , msgs_(totalSlots(capacityPerOwner), backing) {
+        std::cout << "RemoteFreePool initialized for type: " << typeid(Msg).name() << " with " << 
+            MaxOwners << " owners of " << capacityPerOwner << " msgs\n";
+    }
+    ~RemoteFreePool() {
+        if constexpr (Tracker::enabled) {
+            for (size_t i = 0; i < numHeaps_.load(std::memory_order_acquire); ++i) 
+                heaps_[i]->tracker.reportLeaks(typeid(*this).name());
+        }
+        // here, not in ~Heap: a thread may hold its Heap past the storage
+        if constexpr (!std::is_trivially_destructible_v<Msg>) {
+            for (size_t i = 0; i < numHeaps_.load(std::memory_order_acquire); ++i) {
+                for (size_t j = 0; j < capacityPerOwner_; ++j) 
+                    heaps_[i]->msgs[j].~Msg();
+            }
+        }
+    }
+    MsgPtr allocate() {
+        Heap& heap = *threadHeap(true);
+        if (heap.local.empty()) [[unlikely]] {
+            drainRemote(heap);
+            if (heap.local.empty()) {
+                exhausted_.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+        }
+        MsgPtr msg = heap.local.back();
+        heap.local.pop_back();
+        const size_t inUse = capacityPerOwner_ - heap.local.size();
+        heap.localFree.store(heap.local.size(), std::memory_order_relaxed);
+        if (inUse > heap.highWatermark.load(std::memory_order_relaxed))
+            heap.highWatermark.store(inUse, std::memory_order_relaxed);
+        if constexpr (Tracker::enabled) 
+            heap.tracker.onAllocate(heap.slotOf(msg));
+        return msg;
     }
 
     void deallocate(MsgPtr msg) {
         if (msg == nullptr) {
             throw std::runtime_error("Cannot deallocate nullptr");
         }
-        size_t index = (size_t)(msg - &pool_[0]);
+        Heap* mine = threadHeap(false);
+        if (mine && mine->contains(msg)) [[likely]] {
+            if constexpr (Tracker::enabled) 
+                mine->tracker.onDeallocate(mine->slotOf(msg));
+            mine->local.push_back(msg);
+            mine->localFree.store(mine->local.size(), std::memory_order_relaxed);
+            return;
+        }
+        const size_t slot = msgs_.slotOf(reinterpret_cast<const Slot*>(msg)); // throws for foreign pointers
+        Heap& owner = heapAt(slot / capacityPerOwner_);
+        const uint32_t index = static_cast<uint32_t>(slot % capacityPerOwner_);
+        if constexpr (Tracker::enabled) 
+            owner.tracker.onDeallocate(index);
+        uint32_t head = owner.remoteHead.load(std::memory_order_relaxed);
+        do {
+            owner.remoteNext[index] = head;
+        } while (!owner.remoteHead.compare_exchange_weak(head, index, 
+                    std::memory_order_release, std::memory_order_relaxed));
+    }
 
-        size_t oldHead = head_.load(std::memory_order_acquire);
-        while (true) {
-            size_t headIndex;
-            uint32_t tag;
-            unpack(oldHead, headIndex, tag);
-            nextFree_[index] = headIndex;
-            size_t newHead = pack(index, tag + 1);
-            if (head_.compare_exchange_weak(oldHead, newHead,
-                        std::memory_order_acq_rel, std::memory_order_acquire)) {
-                return;
-            }
+    PoolStats stats() const {
+        PoolStats stats{};
+        const size_t numHeaps = numHeaps_.load(std::memory_order_acquire);
+        for (size_t i = 0; i < numHeaps; ++i) {
+            const Heap& heap = *heaps_[i];
+            stats.capacity += capacityPerOwner_;
+            stats.inUse += capacityPerOwner_ - heap.localFree.load(std::memory_order_relaxed);
+            stats.highWatermark += heap.highWatermark.load(std::memory_order_relaxed);
         }
+        stats.exhausted = exhausted_.load(std::memory_order_relaxed);
+        stats.slabs = numHeaps;
+        return stats;
     }
+    // Remote frees drained by owners so far, how much of the traffic crossed threads
+    uint64_t remoteDrained() const {
+        uint64_t drained = 0;
+        for (size_t i = 0; i < numHeaps_.load(std::memory_order_acquire); ++i) {
+            drained += heaps_[i]->drained.load(std::memory_order_relaxed);
+        }
+        return drained;
+    }
+
 private:
-    std::vector<Msg> pool_;
-    std::vector<size_t> nextFree_;
-    std::atomic<size_t> head_; // lower 32 bits: index, upper 32 bits: tag
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+    using Tracker = PoolSlotTracker<>;
+    // Raw storage for one msg, constructed by the heap that claims its range
+    struct alignas(Msg) Slot {
+        std::byte bytes[sizeof(Msg)];
+    };
+    static_assert(sizeof(Slot) == sizeof(Msg));
 
-    static constexpr size_t INDEX_MASK = 0xFFFFFFFF;
-    static constexpr size_t TAG_SHIFT = 32;
+    struct Heap {
+        Heap(MsgPtr first, size_t count)
+                : msgs(first), count(count), remoteNext(new uint32_t[count]), tracker(count) {
+            if constexpr (!std::is_trivially_default_constructible_v<Msg>) {
+                for (size_t i = 0; i < count; ++i) 
+                    new (msgs + i) Msg();
+            }
+            local.reserve(count);
+            for (size_t i = count; i-- > 0;) {
+                local.push_back(msgs + i);
+            }
+            localFree.store(count, std::memory_order_relaxed);
+        }
+        bool contains(const Msg* msg) const { return msg >= msgs && msg < msgs + count; }
+        // Index in this heap, throws for pointers into the middle of a slot (or elsewhere)
+        size_t slotOf(const Msg* msg) const {
+            const uintptr_t offset = reinterpret_cast<uintptr_t>(msg) - reinterpret_cast<uintptr_t>(msgs);
+            if (!contains(msg) || offset % sizeof(Msg) != 0) {
+                throw std::invalid_argument("Message does not belong to this pool");
+            }
+            return offset / sizeof(Msg);
+        }
+        std::atomic<bool> owned{ true };
+        const MsgPtr msgs;                        // this heap's range of the pool storage
+        const size_t count;
+        std::vector<MsgPtr> local;                // owner thread only
+        std::atomic<size_t> localFree;            // mirror of local.size() for stats()
+        std::atomic<size_t> highWatermark{ 0 };
+        std::atomic<uint64_t> drained{ 0 };
+        std::unique_ptr<uint32_t[]> remoteNext;   // written by the freeing thread before its CAS
+        [[no_unique_address]] Tracker tracker;    // slots of this heap, owner and remote frees
+        alignas(64) std::atomic<uint32_t> remoteHead{ EMPTY };
+        char pad_[64 - sizeof(std::atomic<uint32_t>)];
+    };
 
-    inline size_t pack(size_t index, uint32_t tag) {
-        return (static_cast<size_t>(tag) << TAG_SHIFT) | (static_cast<uint32_t>(index));
+    void drainRemote(Heap& heap) {
+        uint32_t index = heap.remoteHead.exchange(EMPTY, std::memory_order_acquire);
+        size_t count = 0;
+        while (index != EMPTY) {
+            heap.local.push_back(heap.msgs + index);
+            index = heap.remoteNext[index];
+            ++count;
+        }
+        heap.drained.fetch_add(count, std::memory_order_relaxed);
     }
 
-    inline void unpack(size_t packed, size_t &index, uint32_t &tag) {
-        index = static_cast<size_t>(packed & INDEX_MASK);
-        tag = static_cast<uint32_t>(packed >> TAG_SHIFT);
+    static size_t totalSlots(size_t capacityPerOwner) {
+        if (capacityPerOwner == 0 || capacityPerOwner >= EMPTY) {
+            throw std::invalid_argument("RemoteFreePool capacity per owner must be in (0, 4G)");
+        }
+        return capacityPerOwner * MaxOwners;
+    }
+    // Heap i owns slots [i * capacity, (i + 1) * capacity)
+    Heap& heapAt(size_t owner) const {
+        if (owner >= numHeaps_.load(std::memory_order_acquire)) [[unlikely]] {
+            throw std::invalid_argument("Message does not belong to this pool");
+        }
+        return *heaps_[owner];
     }
+
+    // Heaps owned by the calling thread, released at thread exit. Shared with the
+    // pool, so either side may go first. last is nullptr when lastId owns no heap
+    // (a consumer thread that only frees), so its frees skip the map lookup too
+    struct ThreadHeaps {
+        uint64_t lastId = 0;
+        Heap* last = nullptr;
+        std::unordered_map<uint64_t, std::shared_ptr<Heap>> byPool;
+        ~ThreadHeaps() {
+            for (auto& [id, heap] : byPool) {
+                heap->owned.store(false, std::memory_order_release);
+            }
+        }
+    };
+    inline Heap* threadHeap(bool claim) {
+        thread_local ThreadHeaps heaps;
+        if (heaps.lastId == id_ && (heaps.last || !claim)) [[likely]] {
+            return heaps.last;
+        }
+        auto it = heaps.byPool.find(id_);
+        if (it == heaps.byPool.end()) {
+            if (!claim) {
+                heaps.lastId = id_;
+                heaps.last = nullptr;
+                return nullptr;
+            }
+            it = heaps.byPool.emplace(id_, claimHeap()).first;
+        }
+        heaps.lastId = id_;
+        heaps.last = it->second.get();
+        return heaps.last;
+    }
+    std::shared_ptr<Heap> claimHeap() {
+        std::lock_guard<std::mutex> lock(heapsMutex_);
+        const size_t numHeaps = numHeaps_.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < numHeaps; ++i) {
+            bool owned = false;
+            if (heaps_[i]->owned.compare_exchange_strong(owned, true, std::memory_order_acquire)) {
+                return heaps_[i];
+            }
+        }
+        if (numHeaps == MaxOwners) {
+            throw std::runtime_error("RemoteFreePool: more allocating threads than MaxOwners");
+        }
+        heaps_[numHeaps] = std::make_shared<Heap>(
+            reinterpret_cast<MsgPtr>(msgs_.data() + numHeaps * capacityPerOwner_), capacityPerOwner_);
+        numHeaps_.store(numHeaps + 1, std::memory_order_release);
+        return heaps_[numHeaps];
+    }
+
+    const size_t capacityPerOwner_;
+    PoolStorage<Slot> msgs_;                      // MaxOwners heaps side by side
+    std::array<std::shared_ptr<Heap>, MaxOwners> heaps_;
+    std::atomic<size_t> numHeaps_{ 0 };
+    std::atomic<uint64_t> exhausted_{ 0 };
+    std::mutex heapsMutex_;
+    const uint64_t id_ = nextId_.fetch_add(1, std::memory_order_relaxed);
+    inline static std::atomic<uint64_t> nextId_{ 1 };
 };
 
 #ifdef USE_FOLLY_MEM_POOL
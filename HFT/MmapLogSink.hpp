@@ -0,0 +1,285 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <fcntl.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "AsyncLogger.hpp"
+
+extern char** environ;
+
+namespace Const {
+#ifdef LOG_SEGMENT_BYTES
+    constexpr size_t logSegmentBytes = LOG_SEGMENT_BYTES;
+#else
+    constexpr size_t logSegmentBytes = 64 << 20;
+#endif
+#ifdef LOG_SYNC_INTERVAL_MS
+    constexpr uint32_t logSyncIntervalMs = LOG_SYNC_INTERVAL_MS;
+#else
+    constexpr uint32_t logSyncIntervalMs = 100;
+#endif
+};
+
+struct MmapLogOptions {
+    size_t segmentBytes = Const::logSegmentBytes;
+    uint32_t syncIntervalMs = Const::logSyncIntervalMs;
+    std::string compressCommand = "gzip";   // run on every closed segment, empty keeps them as they are
+};
+
+/**************************************************************************
+AsyncLogger sink appending into memory mapped, pre-sized file segments
+<path>.000000, <path>.000001, ... A batch is a memcpy into the mapping, no
+iostream and no syscall on the logger thread.
+
+A helper thread does everything else:
+- prepares the next segment ahead of time (posix_fallocate, mmap with
+  MAP_POPULATE, MADV_SEQUENTIAL), the logger thread swaps it in when the
+  current one is full. If it is not ready yet the logger thread waits for it
+  or maps one itself, counted in syncRotations().
+- msync(MS_ASYNC)s the written part of the active segment every
+  syncIntervalMs and drops the synced pages from the mapping (MADV_DONTNEED,
+  they stay in the page cache) so resident memory stays small.
+- closes full segments (msync, munmap, truncate to the bytes written) and
+  runs compressCommand on them ("gzip" by default, started with posix_spawn,
+  no library dependency).
+Segments are consecutive pieces of one stream, writes are split at segment
+boundaries: concatenate them in order (zcat <path>.* for gzip) to read the
+log, binary logs included. Writes that find no segment (mapping failed) are
+counted in lostBytes().
+**************************************************************************/
+class MmapLogSink : public LogSink {
+public:
+    explicit MmapLogSink(std::string path, const MmapLogOptions& options = {})
+            : path_(std::move(path))
+            , options_(options)
+            , pageSize_(static_cast<size_t>(sysconf(_SC_PAGESIZE))) {
+        if (options_.segmentBytes < pageSize_) {
+            throw std::invalid_argument("Log segment smaller than a page");
+        }
+        active_ = map(nextIndex_++);
+        if (!active_.data) {
+            throw std::runtime_error("Cannot map log segment " + segmentPath(0));
+        }
+        helper_ = std::thread(&MmapLogSink::helperThread, this);
+        std::cout << "MmapLogSink initialized with " << options_.segmentBytes << " byte segments at " << path_ << "\n";
+    }
+    ~MmapLogSink() override {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            active_.used = offset_;
+            closing_.push_back(active_);
+            active_ = {};
+            stop_ = true;
+        }
+        cv_.notify_one();
+        helper_.join();
+    }
+    MmapLogSink(const MmapLogSink&) = delete;
+    MmapLogSink& operator=(const MmapLogSink&) = delete;
+
+    // Logger thread only
+    void write(const char* data, size_t len) override {
+        while (len > 0) {
+            if (offset_ == active_.size && !rotate()) [[unlikely]] {
+                lostBytes_.fetch_add(len, std::memory_order_relaxed);
+                return;
+            }
+            const size_t n = std::min(len, active_.size - offset_);
+            std::memcpy(active_.data + offset_, data, n);
+            offset_ += n;
+            data += n;
+            len -= n;
+        }
+        written_.store(offset_, std::memory_order_release);
+    }
+    void flush() override { } // in the page cache already, the helper msyncs
+
+    uint64_t rotations() const { return rotations_.load(std::memory_order_relaxed); }
+    uint64_t syncRotations() const { return syncRotations_.load(std::memory_order_relaxed); }
+    uint64_t lostBytes() const { return lostBytes_.load(std::memory_order_relaxed); }
+    // Blocks until every closed segment is truncated and compressed
+    void waitClosed() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        helperCv_.wait(lock, [&] { return closing_.empty() && !closingBusy_; });
+    }
+    std::string segmentPath(uint64_t index) const {
+        char suffix[16];
+        std::snprintf(suffix, sizeof(suffix), ".%06llu", (unsigned long long)index);
+        return path_ + suffix;
+    }
+
+private:
+    struct Segment {
+        int fd = -1;
+        char* data = nullptr;
+        size_t size = 0;
+        size_t used = 0;
+        uint64_t index = 0;
+    };
+
+    Segment map(uint64_t index) const {
+        Segment segment{ -1, nullptr, options_.segmentBytes, 0, index };
+        const std::string file = segmentPath(index);
+        segment.fd = ::open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (segment.fd < 0)
+            return {};
+        if (::posix_fallocate(segment.fd, 0, segment.size) != 0 && ::ftruncate(segment.fd, segment.size) != 0) {
+            ::close(segment.fd);
+            return {};
+        }
+        void* p = ::mmap(nullptr, segment.size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, segment.fd, 0);
+        if (p == MAP_FAILED) {
+            ::close(segment.fd);
+            return {};
+        }
+        ::madvise(p, segment.size, MADV_SEQUENTIAL);
+        segment.data = static_cast<char*>(p);
+        return segment;
+    }
+
+    // Swaps in the prepared segment, the full one goes to the helper
+    bool rotate() {
+        Segment next;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            active_.used = offset_;
+            closing_.push_back(active_);
+            active_ = {};
+            if (!ready_.data) {
+                syncRotations_.fetch_add(1, std::memory_order_relaxed);
+                helperCv_.wait(lock, [&] { return !preparing_; }); // keeps the segments in order
+            }
+            next = ready_;
+            ready_ = {};
+            if (!next.data)
+                next.index = nextIndex_++;
+        }
+        if (!next.data)
+            next = map(next.index);
+        cv_.notify_one();
+        std::lock_guard<std::mutex> lock(mutex_);
+        active_ = next;
+        offset_ = 0;
+        synced_ = 0;
+        written_.store(0, std::memory_order_release);
+        rotations_.fetch_add(1, std::memory_order_relaxed);
+        return active_.data != nullptr;
+    }
+
+    void helperThread() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            if (!ready_.data && !stop_) {
+                const uint64_t index = nextIndex_++;
+                preparing_ = true;
+                lock.unlock();
+                Segment prepared = map(index);
+                lock.lock();
+                ready_ = prepared;
+                preparing_ = false;
+                helperCv_.notify_all();
+            }
+            while (!closing_.empty()) {
+                Segment segment = closing_.front();
+                closing_.pop_front();
+                closingBusy_ = true;
+                lock.unlock();
+                close(segment);
+                lock.lock();
+                closingBusy_ = false;
+            }
+            helperCv_.notify_all();
+            if (stop_)
+                break;
+            syncActive(lock);
+            cv_.wait_for(lock, std::chrono::milliseconds(options_.syncIntervalMs));
+        }
+        if (ready_.data) { // never used, remove it
+            ::munmap(ready_.data, ready_.size);
+            ::close(ready_.fd);
+            ::unlink(segmentPath(ready_.index).c_str());
+            ready_ = {};
+        }
+    }
+
+    // msync what the logger thread wrote since the last pass, then unmap those pages
+    void syncActive(std::unique_lock<std::mutex>& lock) {
+        if (!active_.data)
+            return;
+        const size_t end = written_.load(std::memory_order_acquire) & ~(pageSize_ - 1);
+        if (end <= synced_)
+            return;
+        char* const data = active_.data;
+        const size_t from = synced_;
+        lock.unlock(); // rotate() waits for the lock, the segment stays mapped until then
+        ::msync(data + from, end - from, MS_ASYNC);
+        ::madvise(data + from, end - from, MADV_DONTNEED);
+        lock.lock();
+        if (active_.data == data)
+            synced_ = end;
+    }
+
+    void close(Segment& segment) {
+        if (segment.data) {
+            ::msync(segment.data, segment.used, MS_SYNC);
+            ::munmap(segment.data, segment.size);
+        }
+        if (segment.fd >= 0) {
+            if (::ftruncate(segment.fd, segment.used) != 0) { }
+            ::close(segment.fd);
+            if (!options_.compressCommand.empty() && segment.used > 0)
+                compress(segmentPath(segment.index));
+        }
+    }
+
+    void compress(const std::string& file) {
+        std::vector<std::string> args;
+        size_t start = 0;
+        const std::string& command = options_.compressCommand;
+        while (start < command.size()) {
+            const size_t end = std::min(command.find(' ', start), command.size());
+            if (end > start) args.push_back(command.substr(start, end - start));
+            start = end + 1;
+        }
+        args.push_back(file);
+        std::vector<char*> argv;
+        for (std::string& arg : args) argv.push_back(arg.data());
+        argv.push_back(nullptr);
+        pid_t pid;
+        if (::posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) == 0) {
+            int status = 0;
+            ::waitpid(pid, &status, 0);
+        }
+    }
+
+    const std::string path_;
+    const MmapLogOptions options_;
+    const size_t pageSize_;
+    Segment active_;                        // swapped under mutex_, written by the logger thread
+    size_t offset_ = 0;                     // logger thread only
+    std::atomic<size_t> written_{ 0 };      // offset_ published for the helper
+    size_t synced_ = 0;                     // under mutex_
+    uint64_t nextIndex_ = 0;                // under mutex_
+    Segment ready_;                         // under mutex_
+    std::deque<Segment> closing_;           // under mutex_
+    bool closingBusy_ = false;              // under mutex_
+    bool preparing_ = false;                // under mutex_
+    bool stop_ = false;                     // under mutex_
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::condition_variable helperCv_;       // helper progress: segment prepared or closed
+    std::atomic<uint64_t> rotations_{ 0 };
+    std::atomic<uint64_t> syncRotations_{ 0 };
+    std::atomic<uint64_t> lostBytes_{ 0 };
+    std::thread helper_;
+};
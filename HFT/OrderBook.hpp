@@ -84,11 +84,14 @@ public:
     }
     
     void update(uint64_t order_id, int new_quantity) {
-        if (!orderMap_.contains(order_id)) {
+        OrderPtr ord = find(order_id);
+        if (!ord) {
             throw std::runtime_error("Order not found");
         }
-        OrderPtr ord = orderMap_[order_id];
-
+        update(ord, new_quantity);
+    }
+    // ord from find(), saves the lookup
+    void update(OrderPtr ord, int new_quantity) {
         if (ord->is_buy) {
             updatePriceLevel<true>(ord->price, (new_quantity - ord->quantity));
         } 
@@ -99,10 +102,14 @@ public:
     }
     
     void cancel(uint64_t order_id) {
-        if (!orderMap_.contains(order_id)) {
+        OrderPtr ord = find(order_id);
+        if (!ord) {
             throw std::runtime_error("Order not found");
         }
-        OrderPtr ord = orderMap_[order_id];
+        cancel(ord);
+    }
+    // ord from find(), only the erase looks the order up
+    void cancel(OrderPtr ord) {
         if (ord->is_buy) {
             updatePriceLevel<true>(ord->price, -ord->quantity);
         } 
@@ -110,12 +117,18 @@ public:
             updatePriceLevel<false>(ord->price, -ord->quantity);
         }
         if constexpr (RequireStorage) {
-            freeMsgPtrs_.emplace_back(orderMap_[order_id]);
+            freeMsgPtrs_.emplace_back(ord);
             --orderCount_;
         }
-        orderMap_.erase(order_id); 
+        orderMap_.erase(ord->order_id); 
     }
     
+    // nullptr when order_id is not in the book
+    OrderPtr find(uint64_t order_id) {
+        OrderPtr* found = orderMap_.find(order_id); // one lookup, nullptr on a miss
+        return found ? *found : nullptr;
+    }
+
     std::pair<double, int> bestBid() const {
         double bestBidPrice = indexToPrice(bestBidIndex_);
         return { bestBidPrice, bidLevels_[bestBidIndex_] };
@@ -1,12 +1,16 @@
 #pragma once
 
 #include <vector>
+#include <array>
 #include <atomic>
+#include <utility>
 #include <iostream>
 #include <concepts>
 #include <queue>
 #include <mutex>
 #include <condition_variable>
+#include <memory>
+#include <unordered_map>
 #include <boost/lockfree/queue.hpp>
 #include "moodycamel/concurrentqueue.h"
 
@@ -21,26 +25,54 @@ namespace Const {
 template <typename T>
 concept MsgPtr = std::is_pointer_v<T>;
 
+// Producer side only, for sinks that are not read in process (ShmTradePublisher)
 template <typename Q>
-concept MyQ = requires(Q q, typename Q::value_type ptr) {
+concept MySendQ = requires(Q q, typename Q::value_type ptr) {
     { q.enqueue(ptr) } -> std::convertible_to<bool>;
+};
+
+template <typename Q>
+concept MyQ = MySendQ<Q> && requires(Q q) {
     { q.dequeue() } -> std::convertible_to<typename Q::value_type>;
 };
 
 /**************************************************************************
 Supported Q types include LockedQueue, CustomSPSCLockFreeQueue, BoostLockFreeQueue,
-CustomMPMCLockFreeQueue and MoodycamelLockFreeQueue. Check TestQueue.cpp for usage examples.
+CustomMPMCLockFreeQueue, CustomMPSCLockFreeQueue, PriorityLaneQueue and MoodycamelLockFreeQueue. Check TestQueue.cpp for usage examples.
 **************************************************************************/
 template <MyQ Q>
 class Queue {
 public:
     Queue() { }
+    explicit Queue(size_t capacity) : queue_(capacity) { }
 	Queue(Queue const&) = delete;
 	Queue& operator=(Queue const&) = delete;
     Queue(Queue&&) = default;
     Queue& operator=(Queue&&) = default;
     bool enqueue(Q::value_type ptr) { return queue_.enqueue(ptr); }
     Q::value_type dequeue() { return queue_.dequeue(); }
+    // Bulk calls return the number of pointers moved. Queues without native bulk 
+    // support fall back to a loop, which may enqueue only part of the batch.
+    size_t enqueueBulk(const typename Q::value_type* ptrs, size_t count) {
+        if constexpr (requires { queue_.enqueueBulk(ptrs, count); }) {
+            return queue_.enqueueBulk(ptrs, count);
+        }
+        else {
+            size_t n = 0;
+            while (n < count && queue_.enqueue(ptrs[n])) ++n;
+            return n;
+        }
+    }
+    size_t dequeueBulk(typename Q::value_type* ptrs, size_t maxCount) {
+        if constexpr (requires { queue_.dequeueBulk(ptrs, maxCount); }) {
+            return queue_.dequeueBulk(ptrs, maxCount);
+        }
+        else {
+            size_t n = 0;
+            while (n < maxCount && (ptrs[n] = queue_.dequeue())) ++n;
+            return n;
+        }
+    }
 private:
     Q queue_;
 };
@@ -50,7 +82,7 @@ template<MsgPtr T>
 class LockedQueue {
 public:
     using value_type = T;
-    LockedQueue() {
+    explicit LockedQueue(size_t /*capacity*/ = Const::queueCapacity) { // unbounded, capacity ignored
         std::cout << "Using LockedQueue\n";
     }
     inline bool enqueue(T ptr) {
@@ -66,6 +98,22 @@ public:
         queue_.pop();
         return msg;
     }
+    inline size_t enqueueBulk(const T* ptrs, size_t count) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < count; ++i) queue_.push(ptrs[i]);
+        cv_.notify_one();
+        return count;
+    }
+    inline size_t dequeueBulk(T* ptrs, size_t maxCount) { // blocks until at least one is available
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [&]{ return !queue_.empty(); });
+        size_t n = 0;
+        for (; n < maxCount && !queue_.empty(); ++n) {
+            ptrs[n] = queue_.front();
+            queue_.pop();
+        }
+        return n;
+    }
 private:
     std::queue<T> queue_;
     std::mutex mutex_;
@@ -77,14 +125,14 @@ template <MsgPtr T>
 class CustomSPSCLockFreeQueue {
 public:
     using value_type = T;
-    CustomSPSCLockFreeQueue() 
-            : buffer_(Const::queueCapacity)
-            , capacity_(Const::queueCapacity)
-            , mask_(Const::queueCapacity - 1) {
+    explicit CustomSPSCLockFreeQueue(size_t capacity = Const::queueCapacity) 
+            : buffer_(capacity)
+            , capacity_(capacity)
+            , mask_(capacity - 1) {
         if (capacity_ == 0 || (capacity_ & mask_) != 0) {
             throw std::invalid_argument("Capacity must be a power of two and greater than zero.");
         }
-        std::cout << "Using CustomSPSCLockFreeQueue " << Const::queueCapacity << " capacity...\n";
+        std::cout << "Using CustomSPSCLockFreeQueue " << capacity_ << " capacity...\n";
     }
     inline bool enqueue(T ptr) {
         const size_t tail = tail_.load(std::memory_order_relaxed);
@@ -97,7 +145,7 @@ public:
         return true;
     }
     inline T dequeue() {
-        if (head_.load(std::memory_order_relaxed) == tail_.load(std::memory_order_relaxed)) {
+        if (head_.load(std::memory_order_relaxed) == tail_.load(std::memory_order_acquire)) {
             return nullptr; 
         }
         const size_t head = head_.fetch_add(1, std::memory_order_acq_rel);
@@ -111,19 +159,24 @@ private:
     size_t mask_{ 0 };
 };
 
-/**************************************************************************/
-template <MsgPtr T>
+/**************************************************************************
+PaddedCells = true gives every cell its own cache line so that producers and 
+consumers working on neighbouring slots do not false share. It costs 64 bytes
+per slot instead of 16, use it when several threads hammer the queue.
+**************************************************************************/
+template <MsgPtr T, bool PaddedCells = false>
 class CustomMPMCLockFreeQueue {
 public:
     using value_type = T;
-    CustomMPMCLockFreeQueue() 
-            : buffer_(Const::queueCapacity)
-            , capacity_(Const::queueCapacity)
-            , mask_(Const::queueCapacity - 1) {
+    explicit CustomMPMCLockFreeQueue(size_t capacity = Const::queueCapacity) 
+            : buffer_(capacity)
+            , capacity_(capacity)
+            , mask_(capacity - 1) {
         if (capacity_ == 0 || (capacity_ & mask_) != 0) {
             throw std::invalid_argument("Capacity must be a power of two and greater than zero.");
         }
-        std::cout << "Using CustomMPMCLockFreeQueue " << Const::queueCapacity << " capacity...\n";
+        std::cout << "Using CustomMPMCLockFreeQueue " << capacity_ << " capacity" << 
+            (PaddedCells ? " (padded cells)" : "") << "...\n";
         for (size_t i = 0; i < capacity_; ++i) {
             buffer_[i].seq.store(i, std::memory_order_relaxed);
         }
@@ -173,15 +226,150 @@ public:
         return value;
     }
 private:
-    struct Cell {
+    struct alignas(PaddedCells ? 64 : alignof(std::atomic<size_t>)) Cell {
         std::atomic<size_t> seq;
         T data;
     };
+    // buffer_, capacity_ and mask_ are read-only after construction, keep them 
+    // together and away from the head_/tail_ lines written by every operation
     std::vector<Cell> buffer_;
+    const size_t capacity_{ 0 };
+    const size_t mask_{ 0 };
     alignas(64) std::atomic<size_t> head_{ 0 };
     alignas(64) std::atomic<size_t> tail_{ 0 };
-    size_t capacity_{ 0 };
-    size_t mask_{ 0 };
+    char pad_[64 - sizeof(std::atomic<size_t>)];
+};
+
+/**************************************************************************
+Bounded multi producer, single consumer queue, e.g. many threads logging into
+AsyncLogger with one thread draining. Producers claim slots like the MPMC queue,
+the consumer owns head_ and does not need a CAS.
+**************************************************************************/
+template <MsgPtr T, bool PaddedCells = true>
+class CustomMPSCLockFreeQueue {
+public:
+    using value_type = T;
+    explicit CustomMPSCLockFreeQueue(size_t capacity = Const::queueCapacity) 
+            : buffer_(capacity)
+            , capacity_(capacity)
+            , mask_(capacity - 1) {
+        if (capacity_ == 0 || (capacity_ & mask_) != 0) {
+            throw std::invalid_argument("Capacity must be a power of two and greater than zero.");
+        }
+        std::cout << "Using CustomMPSCLockFreeQueue " << capacity_ << " capacity" << 
+            (PaddedCells ? " (padded cells)" : "") << "...\n";
+        for (size_t i = 0; i < capacity_; ++i) {
+            buffer_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+    inline bool enqueue(T ptr) {
+        Cell* cell;
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &buffer_[pos & mask_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            int64_t diff = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = ptr;
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+    inline T dequeue() { // Single consumer only
+        Cell* cell = &buffer_[head_ & mask_];
+        if (cell->seq.load(std::memory_order_acquire) != head_ + 1) {
+            return nullptr; // empty, or the producer that claimed this slot has not published yet
+        }
+        T value = cell->data;
+        cell->seq.store(head_ + capacity_, std::memory_order_release);
+        ++head_;
+        return value;
+    }
+private:
+    struct alignas(PaddedCells ? 64 : alignof(std::atomic<size_t>)) Cell {
+        std::atomic<size_t> seq;
+        T data;
+    };
+    std::vector<Cell> buffer_;
+    const size_t capacity_{ 0 };
+    const size_t mask_{ 0 };
+    alignas(64) size_t head_{ 0 };  // consumer owned
+    alignas(64) std::atomic<size_t> tail_{ 0 };
+    char pad_[64 - sizeof(std::atomic<size_t>)];
+};
+
+/**************************************************************************
+Multi lane queue, lane 0 has the highest priority. Every lane is its own
+CustomSPSCLockFreeQueue so each lane must have a single producer, e.g. control
+or invalidation events on lane 0 while the receiver floods the last lane.
+Strict always drains the highest non-empty lane first. Weighted serves lanes
+round robin, up to weight(lane) messages per turn, so a busy control lane
+cannot starve market data. Order is kept within a lane, not across lanes.
+enqueue(ptr) without a lane goes to the last (lowest priority) lane.
+**************************************************************************/
+enum class LanePolicy { Strict, Weighted };
+
+template <MsgPtr T, size_t NumLanes = 2, LanePolicy Policy = LanePolicy::Strict>
+class PriorityLaneQueue {
+    static_assert(NumLanes > 0, "PriorityLaneQueue needs at least one lane");
+public:
+    using value_type = T;
+    explicit PriorityLaneQueue(size_t capacity = Const::queueCapacity) 
+            : PriorityLaneQueue(capacity, std::make_index_sequence<NumLanes>{}) {
+        std::cout << "Using PriorityLaneQueue with " << NumLanes << " lanes...\n";
+        weights_.fill(1);
+    }
+    inline bool enqueue(T ptr) {
+        return lanes_[NumLanes - 1].enqueue(ptr);
+    }
+    inline bool enqueue(T ptr, size_t lane) {
+        return lanes_[lane].enqueue(ptr);
+    }
+    inline T dequeue() {
+        if constexpr (Policy == LanePolicy::Strict) {
+            for (auto& lane : lanes_) {
+                if (T msg = lane.dequeue()) {
+                    return msg;
+                }
+            }
+            return nullptr;
+        }
+        else {
+            for (size_t visited = 0; visited <= NumLanes; ++visited) {
+                if (credit_ > 0) {
+                    if (T msg = lanes_[current_].dequeue()) {
+                        --credit_;
+                        return msg;
+                    }
+                }
+                current_ = (current_ + 1 == NumLanes) ? 0 : current_ + 1;
+                credit_ = weights_[current_];
+            }
+            return nullptr;
+        }
+    }
+    // Weighted only: messages served from a lane before moving on, set before use
+    void setWeight(size_t lane, uint32_t weight) {
+        weights_[lane] = weight ? weight : 1;
+        if (lane == current_) credit_ = weights_[lane];
+    }
+private:
+    template <size_t... Is>
+    PriorityLaneQueue(size_t capacity, std::index_sequence<Is...>) 
+            : lanes_{ ((void)Is, CustomSPSCLockFreeQueue<T>(capacity))... } { }
+
+    std::array<CustomSPSCLockFreeQueue<T>, NumLanes> lanes_;
+    std::array<uint32_t, NumLanes> weights_;
+    size_t current_{ 0 };   // consumer owned
+    uint32_t credit_{ 1 };
 };
 
 /**************************************************************************/
@@ -189,8 +377,8 @@ template <MsgPtr T>
 class BoostLockFreeQueue {
 public:
     using value_type = T;
-    BoostLockFreeQueue() {
-        std::cout << "Using BoostLockFreeQueue " << Const::queueCapacity << " capacity...\n";
+    explicit BoostLockFreeQueue(size_t capacity = Const::queueCapacity) : queue_(capacity) {
+        std::cout << "Using BoostLockFreeQueue " << capacity << " capacity...\n";
     }
     inline bool enqueue(T ptr) {
         return queue_.push(ptr);
@@ -201,29 +389,72 @@ public:
         return msg;
     }
 private:
-    boost::lockfree::queue<T, 
-        boost::lockfree::capacity<Const::queueCapacity>, 
-        boost::lockfree::fixed_sized<true>> queue_;
+    boost::lockfree::queue<T, boost::lockfree::fixed_sized<true>> queue_;
 };
 
-/**************************************************************************/
-template <MsgPtr T>
+/**************************************************************************
+ThreadLocalTokens = true gives every thread its own ProducerToken and ConsumerToken,
+the fast path of moodycamel::ConcurrentQueue which also keeps per producer FIFO order.
+Tokens are owned by the queue so they never outlive it, each thread only caches a 
+raw pointer keyed by a queue id that is never reused.
+**************************************************************************/
+template <MsgPtr T, bool ThreadLocalTokens = false>
 class MoodycamelLockFreeQueue {
 public:
     using value_type = T;
-    MoodycamelLockFreeQueue() : queue_(Const::queueCapacity) {
-        std::cout << "Using MoodycamelLockFreeQueue " << Const::queueCapacity << " capacity...\n";
+    explicit MoodycamelLockFreeQueue(size_t capacity = Const::queueCapacity) : queue_(capacity) {
+        std::cout << "Using MoodycamelLockFreeQueue " << capacity << " capacity" << 
+            (ThreadLocalTokens ? " (thread local tokens)" : "") << "...\n";
     }
     inline bool enqueue(T ptr) {
+        if constexpr (ThreadLocalTokens)
+            return queue_.enqueue(threadToken(producerTokens_), ptr);
         return queue_.enqueue(ptr);
     }
     inline T dequeue() {
         T msg = nullptr;
-        queue_.try_dequeue(msg);
+        if constexpr (ThreadLocalTokens)
+            queue_.try_dequeue(threadToken(consumerTokens_), msg);
+        else 
+            queue_.try_dequeue(msg);
         return msg;
     }
+    inline size_t enqueueBulk(const T* ptrs, size_t count) { // all or nothing
+        if constexpr (ThreadLocalTokens)
+            return queue_.enqueue_bulk(threadToken(producerTokens_), ptrs, count) ? count : 0;
+        return queue_.enqueue_bulk(ptrs, count) ? count : 0;
+    }
+    inline size_t dequeueBulk(T* ptrs, size_t maxCount) {
+        if constexpr (ThreadLocalTokens)
+            return queue_.try_dequeue_bulk(threadToken(consumerTokens_), ptrs, maxCount);
+        return queue_.try_dequeue_bulk(ptrs, maxCount);
+    }
 private:
+    template <typename Token>
+    inline Token& threadToken(std::vector<std::unique_ptr<Token>>& owned) {
+        thread_local uint64_t lastId = 0;
+        thread_local Token* lastToken = nullptr;
+        if (lastId == id_) [[likely]] {
+            return *lastToken;
+        }
+        thread_local std::unordered_map<uint64_t, Token*> tokens;
+        Token*& token = tokens[id_];
+        if (!token) {
+            std::lock_guard<std::mutex> lock(tokenMutex_);
+            token = owned.emplace_back(std::make_unique<Token>(queue_)).get();
+        }
+        lastId = id_;
+        lastToken = token;
+        return *token;
+    }
+
     moodycamel::ConcurrentQueue<T> queue_;
+    // declared after queue_ so the tokens are destroyed first
+    std::vector<std::unique_ptr<moodycamel::ProducerToken>> producerTokens_;
+    std::vector<std::unique_ptr<moodycamel::ConsumerToken>> consumerTokens_;
+    std::mutex tokenMutex_;
+    const uint64_t id_ = nextId_.fetch_add(1, std::memory_order_relaxed);
+    inline static std::atomic<uint64_t> nextId_{ 1 };
 };
 
 /**************************************************************************/
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <new>
+#include <atomic>
+#include <string>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <type_traits>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "Queue.hpp"
+
+enum class ShmRole { Producer, Consumer };
+
+/**************************************************************************
+Inter-process variant of CustomSPSCLockFreeQueue. The ring lives in a named
+POSIX shared memory segment and carries messages inline (no pointers cross the
+process boundary), so the feed handler and a strategy can run as separate
+processes and a crash on one side does not take down the other.
+
+The producer creates (and on destruction unlinks) the segment, the consumer
+attaches to it. Both sides record their pid in the header; isPeerAlive() lets
+either side notice that the other one died. A restarted consumer resumes from
+the head stored in the segment, a restarted producer creates a fresh segment
+and consumers of the old one should re-attach once isPeerAlive() turns false.
+A segment whose producer is still alive is never replaced, a second producer
+on the same name throws. Msg must be trivially copyable.
+**************************************************************************/
+template <typename Msg>
+class ShmSPSCQueue {
+    static_assert(std::is_trivially_copyable_v<Msg>, "ShmSPSCQueue copies messages byte-wise");
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared memory atomics must be lock-free");
+public:
+    using value_type = Msg;
+    ShmSPSCQueue(const std::string& name, ShmRole role, size_t capacity = Const::queueCapacity)
+            : name_(name.starts_with("/") ? name : "/" + name)
+            , role_(role) {
+        if (role_ == ShmRole::Producer) {
+            create(capacity);
+        }
+        else {
+            attach();
+        }
+        std::cout << "Using ShmSPSCQueue " << name_ << " " << capacity_ << " capacity as " <<
+            (role_ == ShmRole::Producer ? "producer" : "consumer") << "...\n";
+    }
+    ~ShmSPSCQueue() {
+        if (header_ == nullptr)
+            return;
+        if (role_ == ShmRole::Producer) {
+            header_->producerPid.store(0, std::memory_order_release);
+            ::shm_unlink(name_.c_str());
+        }
+        else {
+            header_->consumerPid.store(0, std::memory_order_release);
+        }
+        ::munmap(header_, mappedSize_);
+    }
+    ShmSPSCQueue(const ShmSPSCQueue&) = delete;
+    ShmSPSCQueue& operator=(const ShmSPSCQueue&) = delete;
+
+    // Producer: claim() returns the next free slot (nullptr when full), fill it in place then publish()
+    inline Msg* claim() {
+        if (tail_ - cachedHead_ >= capacity_) {
+            cachedHead_ = header_->head.load(std::memory_order_acquire);
+            if (tail_ - cachedHead_ >= capacity_) {
+                return nullptr;
+            }
+        }
+        return &slots_[tail_ & mask_];
+    }
+    inline void publish() {
+        header_->tail.store(++tail_, std::memory_order_release);
+    }
+    inline bool enqueue(const Msg& msg) {
+        Msg* slot = claim();
+        if (!slot) {
+            return false;
+        }
+        std::memcpy(slot, &msg, sizeof(Msg));
+        publish();
+        return true;
+    }
+
+    // Consumer: front() returns the oldest message (nullptr when empty), it stays valid until pop()
+    inline const Msg* front() {
+        if (head_ == cachedTail_) {
+            cachedTail_ = header_->tail.load(std::memory_order_acquire);
+            if (head_ == cachedTail_) {
+                return nullptr;
+            }
+        }
+        return &slots_[head_ & mask_];
+    }
+    inline void pop() {
+        header_->head.store(++head_, std::memory_order_release);
+    }
+    inline bool dequeue(Msg& out) {
+        const Msg* slot = front();
+        if (!slot) {
+            return false;
+        }
+        std::memcpy(&out, slot, sizeof(Msg));
+        pop();
+        return true;
+    }
+
+    bool isPeerAttached() const {
+        return peerPid() != 0;
+    }
+    bool isPeerAlive() const {
+        return isAlive(peerPid());
+    }
+    size_t size() const {
+        return header_->tail.load(std::memory_order_acquire) - header_->head.load(std::memory_order_acquire);
+    }
+    size_t capacity() const { return capacity_; }
+    const std::string& name() const { return name_; }
+
+private:
+    static constexpr uint64_t Magic = 0x51554555'53484d31; // "QUEUSHM1"
+    struct Header {
+        std::atomic<uint64_t> magic;
+        uint64_t msgSize;
+        uint64_t capacity;
+        std::atomic<pid_t> producerPid;
+        std::atomic<pid_t> consumerPid;
+        alignas(64) std::atomic<uint64_t> head; // written by the consumer only
+        alignas(64) std::atomic<uint64_t> tail; // written by the producer only
+        char pad_[64 - sizeof(std::atomic<uint64_t>)];
+    };
+    static constexpr size_t slotsOffset = (sizeof(Header) + 63) & ~size_t(63);
+
+    void create(size_t capacity) {
+        if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+            throw std::invalid_argument("Capacity must be a power of two and greater than zero.");
+        }
+        dropStaleSegment();
+        int fd = ::shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) {
+            throw std::runtime_error("shm_open failed for " + name_ + ": " + std::strerror(errno));
+        }
+        mappedSize_ = slotsOffset + capacity * sizeof(Msg);
+        if (::ftruncate(fd, mappedSize_) < 0) {
+            ::close(fd);
+            ::shm_unlink(name_.c_str());
+            throw std::runtime_error("ftruncate failed for " + name_ + ": " + std::strerror(errno));
+        }
+        map(fd);
+        header_ = new (header_) Header{};
+        header_->msgSize = sizeof(Msg);
+        header_->capacity = capacity;
+        header_->producerPid.store(::getpid(), std::memory_order_relaxed);
+        header_->magic.store(Magic, std::memory_order_release); // publish the initialised header
+        capacity_ = capacity;
+        mask_ = capacity - 1;
+    }
+    void attach() {
+        int fd = ::shm_open(name_.c_str(), O_RDWR, 0);
+        if (fd < 0) {
+            throw std::runtime_error("shm_open failed for " + name_ + ": " + std::strerror(errno));
+        }
+        struct stat st{};
+        if (::fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < slotsOffset) {
+            ::close(fd);
+            throw std::runtime_error("Shared memory segment " + name_ + " is not initialised yet");
+        }
+        mappedSize_ = static_cast<size_t>(st.st_size);
+        map(fd);
+        if (header_->magic.load(std::memory_order_acquire) != Magic || header_->msgSize != sizeof(Msg) ||
+                slotsOffset + header_->capacity * sizeof(Msg) > mappedSize_) {
+            detachOnError("Shared memory segment " + name_ + " has an unexpected layout");
+        }
+        const pid_t current = header_->consumerPid.load(std::memory_order_acquire);
+        if (current != ::getpid() && isAlive(current)) {
+            detachOnError("Shared memory segment " + name_ + " already has a live consumer");
+        }
+        header_->consumerPid.store(::getpid(), std::memory_order_release);
+        capacity_ = header_->capacity;
+        mask_ = capacity_ - 1;
+        head_ = header_->head.load(std::memory_order_acquire); // resume after a consumer restart
+        cachedTail_ = head_;
+    }
+    // Unlinks a segment left by a crashed (or never finished) producer, throws
+    // while its producer is still running
+    void dropStaleSegment() {
+        int fd = ::shm_open(name_.c_str(), O_RDWR, 0);
+        if (fd < 0) {
+            return; // nothing there, or not ours to open and O_EXCL reports it
+        }
+        pid_t producer = 0;
+        struct stat st{};
+        if (::fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(Header)) {
+            void* addr = ::mmap(nullptr, sizeof(Header), PROT_READ, MAP_SHARED, fd, 0);
+            if (addr != MAP_FAILED) {
+                const Header* header = static_cast<const Header*>(addr);
+                if (header->magic.load(std::memory_order_acquire) == Magic)
+                    producer = header->producerPid.load(std::memory_order_acquire);
+                ::munmap(addr, sizeof(Header));
+            }
+        }
+        ::close(fd);
+        if (isAlive(producer)) {
+            throw std::runtime_error("Shared memory segment " + name_ + " already has a live producer");
+        }
+        ::shm_unlink(name_.c_str());
+    }
+    static bool isAlive(pid_t pid) {
+        return pid > 0 && (::kill(pid, 0) == 0 || errno == EPERM);
+    }
+    void map(int fd) {
+        void* addr = ::mmap(nullptr, mappedSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            throw std::runtime_error("mmap failed for " + name_ + ": " + std::strerror(errno));
+        }
+        header_ = static_cast<Header*>(addr);
+        slots_ = reinterpret_cast<Msg*>(static_cast<char*>(addr) + slotsOffset);
+    }
+    [[noreturn]] void detachOnError(const std::string& what) {
+        ::munmap(header_, mappedSize_);
+        header_ = nullptr;
+        throw std::runtime_error(what);
+    }
+    pid_t peerPid() const {
+        return (role_ == ShmRole::Producer ? header_->consumerPid : header_->producerPid)
+                .load(std::memory_order_acquire);
+    }
+
+    const std::string name_;
+    const ShmRole role_;
+    Header* header_{ nullptr };
+    Msg* slots_{ nullptr };
+    size_t mappedSize_{ 0 };
+    size_t capacity_{ 0 };
+    size_t mask_{ 0 };
+    uint64_t head_{ 0 };        // consumer local copy
+    uint64_t cachedTail_{ 0 };  // consumer view of tail, refreshed when it looks empty
+    uint64_t tail_{ 0 };        // producer local copy
+    uint64_t cachedHead_{ 0 };  // producer view of head, refreshed when it looks full
+};
@@ -0,0 +1,81 @@
+// g++ -std=c++20 ITCHStrategy.cpp -o ITCHStrategy -I../ -lrt
+
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <csignal>
+
+#include "ShmQueue.hpp"
+#include "ITCHMessages.hpp"
+
+namespace Config {
+    constexpr std::string shmQueueName = "/itch_trades"; // published by ITCHTradeReceiver
+    constexpr int attachRetryMs = 200;
+    constexpr uint64_t reportEvery = 100'000;
+};
+
+std::atomic<bool> runFlag{true};
+
+/**************************************************************************
+Strategy side of the ITCHTradeReceiver split. Attaches to the sequenced trade
+stream, checks continuity and re-attaches when the feed handler restarts.
+**************************************************************************/
+class TradeStrategy {
+public:
+    void run() {
+        while (runFlag.load(std::memory_order_relaxed)) {
+            auto queue = attach();
+            if (!queue)
+                break;
+            consume(*queue);
+            std::cout << "Feed handler gone, re-attaching...\n";
+        }
+        std::cout << "TradeStrategy end [received: " << received_ << "] [gaps: " << gaps_ << "]\n";
+    }
+private:
+    std::unique_ptr<ShmSPSCQueue<ITCHTradeMsg>> attach() {
+        while (runFlag.load(std::memory_order_relaxed)) {
+            try {
+                return std::make_unique<ShmSPSCQueue<ITCHTradeMsg>>(Config::shmQueueName, ShmRole::Consumer);
+            } catch (const std::exception& ex) {
+                std::cerr << "Waiting for feed handler: " << ex.what() << "\n";
+                std::this_thread::sleep_for(std::chrono::milliseconds(Config::attachRetryMs));
+            }
+        }
+        return nullptr;
+    }
+    void consume(ShmSPSCQueue<ITCHTradeMsg>& queue) {
+        uint64_t idle = 0;
+        while (runFlag.load(std::memory_order_relaxed)) {
+            const ITCHTradeMsg* msg = queue.front();
+            if (!msg) {
+                if ((++idle & 0xFFFF) == 0 && !queue.isPeerAlive())
+                    return;
+                continue;
+            }
+            onTrade(*msg);
+            queue.pop();
+        }
+    }
+    void onTrade(const ITCHTradeMsg& msg) {
+        if (nextSequence_ != 0 && msg.sequence_number != nextSequence_) [[unlikely]] {
+            std::cerr << "Sequence gap [expected: " << nextSequence_ << "] [received: " << msg.sequence_number << "]\n";
+            ++gaps_;
+        }
+        nextSequence_ = msg.sequence_number + 1;
+        if (++received_ % Config::reportEvery == 0) {
+            std::cout << "Received " << received_ << " trades, last seq " << msg.sequence_number <<
+                " price " << msg.price << "\n";
+        }
+    }
+    uint64_t nextSequence_ = 0;
+    uint64_t received_ = 0;
+    uint64_t gaps_ = 0;
+};
+
+/**************************************************************************/
+int main() {
+    std::signal(SIGINT, [](int) { runFlag.store(false); });
+    TradeStrategy strategy;
+    strategy.run();
+}
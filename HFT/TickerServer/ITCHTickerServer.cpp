@@ -7,7 +7,6 @@
 #include <unistd.h>
 #include <fstream>
 #include <string>
-#include <sstream>
 #include <vector>
 #include <array>
 #include <thread>
@@ -60,34 +59,10 @@ private:
     | 5           | Is Buyer Maker (bool)   | True if buyer is maker (passive order)      |
     | 6           | Is Best Match (bool)    | True if this trade is the best price match? |
     */
-    void parseTrade(std::string& line) {
+    void parseTrade(const std::string& line) {
         ITCHTradeMsg msg {};
-        msg.message_type = 'P';
-        msg.sequence_number = vec_.size();
-        
-        std::istringstream ss(line);
-        std::string token {};
-        
-        std::getline(ss, token, ',');
-        msg.trade_id = std::stoull(token);
-
-        std::getline(ss, token, ',');
-        msg.price = std::stod(token);
-
-        std::getline(ss, token, ',');
-        msg.quantity = std::stod(token);
-
-        std::getline(ss, token, ','); // Skip Quote Quantity as it is (price*quantity)
-        
-        std::getline(ss, token, ',');
-        msg.timestamp = std::stoull(token);
-
-        std::getline(ss, token, ',');
-        msg.buyer_is_maker = (token == "True");
-
-        std::getline(ss, token, ',');
-        msg.best_match = (token == "True");
-
+        if (!decodeTradeCsv(line, vec_.size(), msg))
+            throw std::runtime_error("Malformed trade line: " + line);
         vec_.emplace_back(msg);
     }
     std::vector<ITCHTradeMsg> vec_;
@@ -1,19 +1,21 @@
-// g++ -std=c++20 ITCHTradeReceiver.cpp -o ITCHTradeReceiver -I../ -DPOOL_MSG_COUNT=400000
+// g++ -std=c++20 ITCHTradeReceiver.cpp -o ITCHTradeReceiver -I../
+// add -DLOG_MIN_LEVEL=1 to compile out the debug() lines
 
 #include <thread>
 #include <chrono>
 #include <functional>
+#include <cerrno>
 #include <fstream>
 
 #include "Socket.hpp"
 #include "Queue.hpp"
+#include "ShmQueue.hpp"
 #include "HashMap.hpp"
 #include "MemoryPool.hpp"
 #include "AsyncLogger.hpp"
 #include "ITCHMessages.hpp"
 
 namespace Config {
-    constexpr bool debug = true;
     constexpr std::string multicastIP = "239.255.0.1";
     constexpr int multicastPort = 30001;
 
@@ -21,6 +23,11 @@ namespace Config {
     constexpr int recoveryPort = 8080;
     constexpr int maxSnapshotEvents = 100;
     constexpr int recoveryConnectionAttempts = 50;
+
+    constexpr std::string shmQueueName = "/itch_trades"; // attach with ITCHStrategy
+
+    constexpr size_t msgPoolCapacity = 1 << 18;     // grows by this many msgs when a burst runs it dry
+    constexpr size_t msgPoolMaxCapacity = 1 << 22;
 };
 
 /**************************************************************************/
@@ -71,8 +78,7 @@ public:
     }
 private:
     void sendRecoveryRequest(const uint64_t startSeq, const uint64_t endSeq) {
-        if constexpr (Config::debug) 
-            logger_.log("sendRecoveryRequest start:%llu end %llu\n", startSeq, endSeq);
+        logger_.debug("sendRecoveryRequest start:%llu end %llu\n", startSeq, endSeq);
         ITCHGapRequestMsg req{'0', startSeq, endSeq};
         ssize_t sent = send(socketFD_.get(), &req, sizeof(req), 0);
         if (sent != sizeof(req)) [[unlikely]]
@@ -96,10 +102,12 @@ private:
         while (messagesReceived < numMessages) {
             int nfds = epoll_wait(epollFD.get(), &event, 1, 5000);  // 5s timeout
             if (nfds > 0 && event.events & EPOLLIN) [[likely]] {
-                TradeMsgPtr msg = msgPool_.allocate();
-                ssize_t bytes = recv(socketFD_.get(), msg, ITCHTradeMsgSize, MSG_WAITALL);
+                auto msg = msgPool_.make(); // back to the pool unless handed to the sequencer
+                if (!msg) [[unlikely]] {
+                    throw std::runtime_error("Msg Pool exhausted at receiveRecoveryMessages");
+                }
+                ssize_t bytes = recv(socketFD_.get(), msg.get(), ITCHTradeMsgSize, MSG_WAITALL);
                 if (bytes != ITCHTradeMsgSize) [[unlikely]] {
-                    msgPool_.deallocate(msg);
                     if (bytes <= 0) {
                         std::cerr << "Connection closed or error\n"; // TODO : Add reconnect attempt
                         break;
@@ -109,9 +117,8 @@ private:
                     }
                     continue;
                 }
-                if constexpr (Config::debug) 
-                    logger_.log("receiveRecoveryMessages received:%llu\n", msg->sequence_number);
-                sequencerOnMsgCB_(msg);
+                logger_.debug("receiveRecoveryMessages received:%llu\n", msg->sequence_number);
+                sequencerOnMsgCB_(msg.release());
                 ++messagesReceived;
             } 
             else [[unlikely]] {
@@ -133,17 +140,20 @@ private:
 };
 
 /**************************************************************************/
-template <typename TradeMsg, MyQ RecvMsgQueue, MyQ SendMsgQueue, MyPool Pool>
+template <typename TradeMsg, MyQ RecvMsgQueue, MySendQ SendMsgQueue, MyPool Pool>
 class TradeDataSequencer {
 public:
     using TradeMsgPtr = TradeMsg*;
 
-    TradeDataSequencer(RecvMsgQueue& recvQueue, SendMsgQueue& sendQueue, Pool& pool, AsyncLogger& logger) 
+    // journal gets every sequenced message, gaps and recoveries (LogOutput::Journal)
+    TradeDataSequencer(RecvMsgQueue& recvQueue, SendMsgQueue& sendQueue, Pool& pool, AsyncLogger& logger, 
+            AsyncLogger& journal) 
             : recvQueue_(recvQueue)
             , sendQueue_(sendQueue)
             , msgPool_(pool)
             , tradeRecoveryManager_([this](TradeMsgPtr msg) { onRecoveredMsg(msg); }, pool, logger)
-            , logger_(logger) {
+            , logger_(logger)
+            , journal_(journal) {
         
     }
     ~TradeDataSequencer() {
@@ -164,18 +174,20 @@ public:
             }
             if (msg->sequence_number > nextSequence_) [[unlikely]] {
                 // TODO : Send an invalidate message, avoid taking decisions on stale data
-                logger_.log("Gap from %llu to %llu, initiating recovery\n", nextSequence_, msg->sequence_number - 1);
-                tradeRecoveryManager_.recover(nextSequence_, msg->sequence_number - 1); // Blocking, required to keep the sequence
+                const uint64_t from = nextSequence_, to = msg->sequence_number - 1;
+                logger_.warn("Gap from %llu to %llu, initiating recovery\n", from, to);
+                journal_.journal(JournalGap{ from, to });
+                tradeRecoveryManager_.recover(from, to); // Blocking, required to keep the sequence
+                journal_.journal(JournalRecovery{ from, to, nextSequence_ - from });
                 // TODO : Not here, but send a validate message, considering some condition
             } 
             else if (msg->sequence_number < nextSequence_) [[unlikely]] { // Old message received, drop message   
-                if constexpr (Config::debug) 
-                    logger_.log("MC Old msg received, drop! expected %llu, got %llu\n", nextSequence_, msg->sequence_number);
-                msgPool_.deallocate(msg);
+                logger_.debug("MC Old msg received, drop! expected %llu, got %llu\n", nextSequence_, msg->sequence_number);
+                msgPool_.destroy(msg);
                 continue;
             }
-            if constexpr (Config::debug) 
-                logger_.log("TradeDataSequencer received msg %llu\n", msg->sequence_number);
+            logger_.debug("TradeDataSequencer received msg %llu\n", msg->sequence_number);
+            journal_.journal(JournalItchTrade{ *msg }); // before the queue takes msg
             sendQueue_.enqueue(msg);
             ++nextSequence_;
         }    
@@ -191,6 +203,7 @@ private:
                 "expected: " << nextSequence_ << "\n";
             throw std::runtime_error("Failed to recover message");
         }
+        journal_.journal(JournalItchTrade{ *msg });
         sendQueue_.enqueue(msg);
         ++nextSequence_;
     }
@@ -199,6 +212,7 @@ private:
     Pool& msgPool_;
     TradeRecoveryManager<TradeMsg, Pool> tradeRecoveryManager_;
     AsyncLogger& logger_;
+    AsyncLogger& journal_;
     uint64_t nextSequence_ = 0;
     alignas(64) std::atomic<bool> runFlag_{true};
 };
@@ -221,7 +235,7 @@ public:
         runFlag_.store(false, std::memory_order_relaxed);
     }
     void connect() {
-        if constexpr (Config::debug) logger_.log("connect MulticastTradeDataReceiver\n");
+        logger_.debug("connect MulticastTradeDataReceiver\n");
         
         socketFD_ = Socket(AF_INET, SOCK_DGRAM, 0);
         if (socketFD_.get() < 0) {
@@ -256,18 +270,22 @@ public:
     void run() {
         logger_.log("running MulticastTradeDataReceiver\n");
         while (runFlag_.load(std::memory_order_relaxed)) {
-            TradeMsgPtr msg = pool_.allocate();
+            auto msg = pool_.make(); // back to the pool unless the queue takes it
             if (!msg) {
                 throw std::runtime_error("Msg Pool exhausted at MulticastTradeDataReceiver");
             }
-            ssize_t len = recv(socketFD_.get(), msg, ITCHTradeMsgSize, 0);
+            ssize_t len = recv(socketFD_.get(), msg.get(), ITCHTradeMsgSize, 0);
             if (len < 0) [[unlikely]] {
-                std::cerr << "MulticastTradeDataReceiver recv failed";
-                pool_.deallocate(msg);
+                LOG_RATE_LIMITED(logger_, LogLevel::Error, 10, "MulticastTradeDataReceiver recv failed, errno %d\n", errno);
                 continue;
             }
-            queue_.enqueue(msg);
-            //if constexpr (Config::debug) logger_.log("MC received msg %llu\n", msg->sequence_number);
+            LOG_EVERY_N(logger_, LogLevel::Debug, 100000, "MC received msg %llu\n", msg->sequence_number);
+            if (queue_.enqueue(msg.get())) [[likely]] {
+                msg.release();
+            }
+            else {
+                LOG_FIRST_N(logger_, LogLevel::Warn, 10, "MC queue full, msg %llu dropped\n", msg->sequence_number);
+            }
         }
     }
 private:
@@ -278,16 +296,71 @@ private:
     alignas(64) std::atomic<bool> runFlag_{true};
 };
 
+/**************************************************************************
+Satisfies MySendQ so TradeDataSequencer can publish to a strategy running in
+another process. The message is copied into the shared memory ring and returned
+to the pool right away; when the strategy is down or lagging the message is
+dropped and counted instead of blocking the sequencer. Drops are logged rate
+limited, and the consumer's liveness is checked on the first drop and every
+65536th after it, logging when the strategy goes away or comes back.
+**************************************************************************/
+template <typename TradeMsg, MyPool Pool>
+class ShmTradePublisher {
+public:
+    using value_type = TradeMsg*;
+    ShmTradePublisher(const std::string& name, Pool& pool, AsyncLogger& logger)
+            : queue_(name, ShmRole::Producer)
+            , pool_(pool)
+            , logger_(logger) {
+
+    }
+    bool enqueue(TradeMsg* msg) {
+        const bool published = queue_.enqueue(*msg);
+        if (!published) [[unlikely]] {
+            onDrop(msg->sequence_number);
+        }
+        pool_.destroy(msg);
+        return published;
+    }
+    uint64_t dropped() const { return dropped_; }
+    bool isConsumerAlive() const { return queue_.isPeerAlive(); }
+private:
+    void onDrop(uint64_t sequence) {
+        if ((dropped_++ & 0xFFFF) == 0) { // kill() is a syscall, poll it rarely
+            const bool alive = isConsumerAlive();
+            if (alive != consumerAlive_) {
+                if (alive) 
+                    logger_.info("Strategy attached to %s again\n", queue_.name().c_str());
+                else 
+                    logger_.warn("No strategy attached to %s, dropping sequenced msgs\n", queue_.name().c_str());
+                consumerAlive_ = alive;
+            }
+        }
+        if (consumerAlive_) 
+            LOG_RATE_LIMITED(logger_, LogLevel::Warn, 10, "Strategy queue %s full, msg %llu dropped\n", 
+                queue_.name().c_str(), sequence);
+    }
+
+    ShmSPSCQueue<TradeMsg> queue_;
+    Pool& pool_;
+    AsyncLogger& logger_;
+    uint64_t dropped_ = 0;
+    bool consumerAlive_ = true;             // as of the last check
+};
+
 /**************************************************************************/
 int main() {
     std::ofstream file("log_ITCHTradeReceiver.txt"); 
     AsyncLogger logger(file); // Can use std::cout instead of file
+    std::ofstream journalFile("ITCHTradeReceiver.journal", std::ios::binary); // replay with JournalReplay
+    AsyncLogger journal(journalFile, LogOutput::Journal);
 
     logger.log("Main Start\n");
 
-    using MsgPool = LockFreeThreadSafePool<ITCHTradeMsg, true>;
+    using MsgPool = MemoryPool<LockFreeThreadSafePool<ITCHTradeMsg, true>>;
     using TradeReceiverToSequencerQ = CustomSPSCLockFreeQueue<ITCHTradeMsg*>;
-    using SequencerToXQ = CustomSPSCLockFreeQueue<ITCHTradeMsg*>; // can use CustomMPMCLockFreeQueue as well
+    // Publish to a separate strategy process, CustomSPSCLockFreeQueue<ITCHTradeMsg*> keeps it in process
+    using SequencerToXQ = ShmTradePublisher<ITCHTradeMsg, MsgPool>;
 
     using TradeDataSequencerT = TradeDataSequencer<ITCHTradeMsg, TradeReceiverToSequencerQ, 
                                             SequencerToXQ, MsgPool>;
@@ -295,11 +368,11 @@ int main() {
                                             TradeReceiverToSequencerQ, MsgPool>;
 
     TradeReceiverToSequencerQ tradeReceiverToSequencerQ;
-    SequencerToXQ sendQ;
-    MsgPool msgPool;
+    MsgPool msgPool(Config::msgPoolCapacity, PoolBacking{}, Config::msgPoolMaxCapacity);
+    SequencerToXQ sendQ(Config::shmQueueName, msgPool, logger);
 
     MulticastTradeDataReceiverT multicastTradeReceiver(tradeReceiverToSequencerQ, msgPool, logger);
-    TradeDataSequencerT tradeSequencer(tradeReceiverToSequencerQ, sendQ, msgPool, logger);
+    TradeDataSequencerT tradeSequencer(tradeReceiverToSequencerQ, sendQ, msgPool, logger, journal);
     
     multicastTradeReceiver.connect();
     std::this_thread::sleep_for(std::chrono::seconds(1)); // Check for readiness using a different method, login msg?
@@ -323,5 +396,9 @@ int main() {
     for (auto& thr : threads) 
         thr.join();
     
-    logger.log("Main End\n");
+    const PoolStats poolStats = msgPool.stats();
+    logger.log("Msg Pool [capacity: %zu] [slabs: %zu] [high watermark: %zu] [exhausted: %llu]\n", 
+        poolStats.capacity, poolStats.slabs, poolStats.highWatermark, 
+        static_cast<unsigned long long>(poolStats.exhausted));
+    logger.log("Main End [dropped by strategy queue: %llu]\n", sendQ.dropped());
 }
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cmath>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace Const {
+#ifdef TSC_CALIBRATION_MS
+    constexpr uint32_t tscCalibrationMs = TSC_CALIBRATION_MS;
+#else
+    constexpr uint32_t tscCalibrationMs = 1000;
+#endif
+};
+
+/**************************************************************************
+Call site timestamps for a few ns: now() is rdtsc (steady_clock ns on other
+architectures), toNs() maps a tick count to wall clock ns since the epoch.
+The mapping is an anchor (ticks, wall ns) plus a rate. recalibrate() measures
+the rate over the time since the last anchor and moves the anchor, call it
+from one background thread whenever due() says so. A rate more than 1% off
+the previous one (wall clock stepped) only moves the anchor.
+Assumes an invariant TSC synchronised across cores (any recent x86).
+Not thread-safe, the owning thread converts.
+**************************************************************************/
+class TscClock {
+public:
+    static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    // Initial rate from a short busy wait, refined by every recalibrate()
+    TscClock() {
+        anchor_ = sample();
+        const auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(2);
+        while (std::chrono::steady_clock::now() < until) { }
+        const Sample s = sample();
+        if (const double measured = rate(s, anchor_); measured > 0)
+            ticksPerNs_ = measured;
+        anchor_ = s;
+        intervalTicks_ = static_cast<uint64_t>(ticksPerNs_ * Const::tscCalibrationMs * 1e6);
+    }
+
+    bool due(uint64_t ticks) const { return ticks - anchor_.ticks >= intervalTicks_; }
+
+    void recalibrate() {
+        const Sample s = sample();
+        const double measured = rate(s, anchor_);
+        if (measured > 0 && std::fabs(measured - ticksPerNs_) < 0.01 * ticksPerNs_)
+            ticksPerNs_ = measured;
+        anchor_ = s;
+        intervalTicks_ = static_cast<uint64_t>(ticksPerNs_ * Const::tscCalibrationMs * 1e6);
+    }
+
+    // Ticks taken before the anchor map backwards from it
+    uint64_t toNs(uint64_t ticks) const {
+        const double delta = static_cast<double>(static_cast<int64_t>(ticks - anchor_.ticks)) / ticksPerNs_;
+        return static_cast<uint64_t>(anchor_.ns + std::llround(delta));
+    }
+    double ticksPerNs() const { return ticksPerNs_; }
+
+private:
+    struct Sample {
+        uint64_t ticks;
+        int64_t ns;
+    };
+    // Wall clock read between two tick reads, paired with their midpoint
+    static Sample sample() {
+        const uint64_t t0 = now();
+        const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        const uint64_t t1 = now();
+        return { t0 + (t1 - t0) / 2, ns };
+    }
+    static double rate(const Sample& later, const Sample& earlier) {
+        const int64_t ns = later.ns - earlier.ns;
+        return ns > 0 ? static_cast<double>(later.ticks - earlier.ticks) / static_cast<double>(ns) : 0.0;
+    }
+
+    Sample anchor_ {};
+    double ticksPerNs_ = 1.0;
+    uint64_t intervalTicks_ = 0;
+};
@@ -4,12 +4,15 @@
 #include <iostream>                // Standard output
 #include <thread>                  // For using std::thread
 #include <atomic>                  // For thread-safe run flag
+#include <memory_resource>         // For pmr containers on the burst arena
+#include "Arena.hpp"               // Per-burst monotonic arena
 
 constexpr uint16_t PORT_ID = 0;               // Port ID to bind to (typically 0 if only one NIC is bound)
 constexpr uint16_t RX_RING_SIZE = 1024;       // Size of the RX descriptor ring
 constexpr uint16_t TX_RING_SIZE = 1024;       // Size of the TX descriptor ring (unused here)
 constexpr uint16_t NUM_MBUFS = 8192;          // Number of packet buffers in the pool
 constexpr uint16_t BURST_SIZE = 32;           // Number of packets to process in one burst
+constexpr size_t BURST_ARENA_BYTES = 64 << 10; // Scratch memory for one decoded burst
 
 // Structure to hold mock market data
 struct MarketData {
@@ -39,15 +42,25 @@ MarketData parse_packet(const rte_mbuf* mbuf) {
 // Packet receiver loop running on one thread
 void receive_packets(std::atomic<bool>& run_flag) {
     rte_mbuf* bufs[BURST_SIZE];  // Buffer array to receive burst of packets
+    MonotonicArena arena(BURST_ARENA_BYTES, PoolBacking{ .prefault = true }); // Decoded burst lives here
 
     while (run_flag.load()) {    // Continue while main thread says "run"
         uint16_t nb_rx = rte_eth_rx_burst(PORT_ID, 0, bufs, BURST_SIZE); // Receive a burst
+        if (nb_rx == 0) continue;
+
+        ArenaBurst burst(arena);                     // Whole burst is released in O(1) at scope end
+        std::pmr::vector<MarketData> batch(&arena);  // No malloc in steady state
+        batch.reserve(nb_rx);
         for (uint16_t i = 0; i < nb_rx; i++) {
-            MarketData data = parse_packet(bufs[i]); // Parse mock market data
+            batch.push_back(parse_packet(bufs[i])); // Parse mock market data
+            rte_pktmbuf_free(bufs[i]);              // Free the packet buffer
+        }
+        for (const MarketData& data : batch) {
             process_market_data(data);               // Run simple strategy
-            rte_pktmbuf_free(bufs[i]);               // Free the packet buffer
         }
     }
+    std::cout << "Burst arena high watermark " << arena.highWatermark() << " bytes, upstream allocations " 
+        << arena.upstreamAllocations() << std::endl;
 }
 
 int main(int argc, char** argv) {
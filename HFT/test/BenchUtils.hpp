@@ -0,0 +1,251 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/**************************************************************************
+Helpers shared by the Test*.cpp benchmarks: TSC timestamps, core pinning,
+an HDR style latency histogram and a CSV result sink.
+**************************************************************************/
+namespace Bench {
+
+inline uint64_t rdtsc() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+// TSC ticks per nanosecond, measured once against steady_clock
+inline double tscPerNs() {
+    static const double ticksPerNs = [] {
+        using namespace std::chrono;
+        const auto t0 = steady_clock::now();
+        const uint64_t c0 = rdtsc();
+        std::this_thread::sleep_for(milliseconds(50));
+        const auto t1 = steady_clock::now();
+        const uint64_t c1 = rdtsc();
+        return (double)(c1 - c0) / duration_cast<nanoseconds>(t1 - t0).count();
+    }();
+    return ticksPerNs;
+}
+
+inline uint64_t tscToNs(uint64_t ticks) {
+    return static_cast<uint64_t>(ticks / tscPerNs());
+}
+
+// Pin the calling thread, cpu < 0 leaves the affinity untouched
+inline bool pinThread(int cpu) {
+    if (cpu < 0)
+        return true;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        std::cerr << "Failed to pin thread to cpu " << cpu << ", running unpinned\n";
+        return false;
+    }
+    return true;
+}
+
+/**************************************************************************
+Log-linear histogram in the spirit of HdrHistogram: values below 2^SubBits are
+exact, above that every power of two is split into 2^SubBits buckets, giving
+roughly 3% relative precision over the full uint64_t range with a fixed 16KB
+footprint and no allocation on record().
+**************************************************************************/
+class LatencyHistogram {
+public:
+    void record(uint64_t value) {
+        ++counts_[index(value)];
+        ++count_;
+        sum_ += value;
+        if (value < min_) min_ = value;
+        if (value > max_) max_ = value;
+    }
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < counts_.size(); ++i)
+            counts_[i] += other.counts_[i];
+        count_ += other.count_;
+        sum_ += other.sum_;
+        if (other.min_ < min_) min_ = other.min_;
+        if (other.max_ > max_) max_ = other.max_;
+    }
+    void reset() { *this = LatencyHistogram{}; }
+
+    // Highest value equivalent to the bucket holding the given percentile
+    uint64_t percentile(double p) const {
+        if (count_ == 0)
+            return 0;
+        const uint64_t target = static_cast<uint64_t>(p / 100.0 * count_ + 0.5);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts_.size(); ++i) {
+            seen += counts_[i];
+            if (seen >= target && seen > 0)
+                return std::min(highestEquivalent(i), max_);
+        }
+        return max_;
+    }
+    uint64_t count() const { return count_; }
+    uint64_t min() const { return count_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const { return count_ ? (double)sum_ / count_ : 0.0; }
+
+private:
+    static constexpr int SubBits = 5;
+    static constexpr uint64_t SubCount = 1ull << SubBits;
+
+    static size_t index(uint64_t value) {
+        if (value < SubCount)
+            return static_cast<size_t>(value);
+        const int shift = (63 - std::countl_zero(value)) - SubBits;
+        return static_cast<size_t>(((shift + 1) << SubBits) + ((value >> shift) - SubCount));
+    }
+    static uint64_t highestEquivalent(size_t idx) {
+        if (idx < SubCount)
+            return idx;
+        const int shift = static_cast<int>(idx >> SubBits) - 1;
+        const uint64_t sub = (idx & (SubCount - 1)) + SubCount;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    std::array<uint64_t, 64 * SubCount> counts_{};
+    uint64_t count_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t min_ = UINT64_MAX;
+    uint64_t max_ = 0;
+};
+
+/**************************************************************************
+Hardware/software counter for the calling thread via perf_event_open. When the
+kernel refuses (perf_event_paranoid, containers) valid() is false and read()
+returns 0, callers print n/a.
+**************************************************************************/
+class PerfCounter {
+public:
+    static PerfCounter dtlbLoadMisses() {
+        return PerfCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | 
+            (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    }
+    static PerfCounter pageFaults() {
+        return PerfCounter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+    }
+    PerfCounter(uint32_t type, uint64_t config) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_hv = 1;
+        fd_ = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+    ~PerfCounter() { if (fd_ >= 0) ::close(fd_); }
+    PerfCounter(PerfCounter&& other) noexcept : fd_(std::exchange(other.fd_, -1)) { }
+    PerfCounter(const PerfCounter&) = delete;
+
+    bool valid() const { return fd_ >= 0; }
+    void start() {
+        if (fd_ < 0) return;
+        ::ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+        ::ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    uint64_t stop() {
+        if (fd_ < 0) return 0;
+        ::ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t value = 0;
+        if (::read(fd_, &value, sizeof(value)) != sizeof(value)) return 0;
+        return value;
+    }
+private:
+    int fd_ = -1;
+};
+
+// Minor page faults of the whole process so far, works without perf access
+inline uint64_t minorFaults() {
+    rusage usage{};
+    ::getrusage(RUSAGE_SELF, &usage);
+    return static_cast<uint64_t>(usage.ru_minflt);
+}
+
+// Resident set size of the process in KB, from /proc/self/statm
+inline uint64_t residentKb() {
+    std::ifstream statm("/proc/self/statm");
+    uint64_t sizePages = 0, residentPages = 0;
+    statm >> sizePages >> residentPages;
+    return residentPages * static_cast<uint64_t>(::sysconf(_SC_PAGESIZE)) / 1024;
+}
+
+/**************************************************************************
+Appends one row per benchmark run, writes the header only once per file.
+An empty path disables CSV output.
+**************************************************************************/
+class CsvWriter {
+public:
+    CsvWriter(const std::string& path, const std::string& header) {
+        if (path.empty())
+            return;
+        const bool exists = std::ifstream(path).good();
+        file_.open(path, std::ios::app);
+        if (!file_)
+            throw std::runtime_error("Failed to open csv file " + path);
+        if (!exists)
+            file_ << header << "\n";
+    }
+    template <typename... Cols>
+    void row(const Cols&... cols) {
+        if (!file_.is_open())
+            return;
+        bool first = true;
+        ((file_ << (first ? "" : ","), field(cols), first = false), ...);
+        file_ << "\n";
+        file_.flush();
+    }
+private:
+    template <typename T>
+    void field(const T& value) { file_ << value; }
+    // Names like "Pool<Msg, true>" carry commas, quote them (RFC 4180)
+    void field(const std::string& value) {
+        if (value.find_first_of(",\"") == std::string::npos) {
+            file_ << value;
+            return;
+        }
+        file_ << '"';
+        for (char c : value) file_ << (c == '"' ? "\"\"" : std::string(1, c));
+        file_ << '"';
+    }
+    void field(const char* value) { field(std::string(value)); }
+
+    std::ofstream file_;
+};
+
+};
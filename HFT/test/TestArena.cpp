@@ -0,0 +1,195 @@
+/*
+$ g++ -std=c++20 -O3 -o TestArena TestArena.cpp -I../
+$ numactl --physcpubind=4 ./TestArena
+*/
+
+#include "Arena.hpp"
+#include "ITCHMessages.hpp"
+#include "BenchUtils.hpp"
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+// Every heap allocation in the process goes through here so the benchmarks can count them
+static std::atomic<uint64_t> heapAllocations{0};
+
+void* operator new(size_t bytes) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(bytes ? bytes : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t bytes) { return ::operator new(bytes); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+/**************************************************************************/
+void arenaTest() {
+    std::cout << "Testing MonotonicArena...\n";
+    auto check = [](bool ok, const char* what) { // no std::string, it would count as a heap allocation
+        std::cout << "\t" << (ok ? "🟢 " : "🔴 ") << what << "\n";
+    };
+    MonotonicArena arena(16 << 10);
+
+    bool aligned = true;
+    for (size_t alignment : { 1, 2, 8, 16, 64, 256 }) {
+        (void)arena.allocate(1, 1);
+        void* p = arena.allocate(24, alignment);
+        aligned &= (reinterpret_cast<uintptr_t>(p) % alignment) == 0;
+    }
+    check(aligned, "Allocations honour the requested alignment");
+
+    const size_t used = arena.used();
+    arena.reset();
+    check(used > 0 && arena.used() == 0 && arena.highWatermark() == used, "reset() rewinds, high watermark kept");
+
+    const uint64_t before = heapAllocations;
+    {
+        ArenaBurst burst(arena);
+        std::pmr::vector<uint64_t> values(&arena);
+        for (uint64_t i = 0; i < 256; ++i) values.push_back(i);
+        std::pmr::string text("a pmr string long enough to skip the small string buffer", &arena);
+        check(values[255] == 255 && text.size() > 16, "pmr vector and string on the arena");
+    }
+    check(heapAllocations == before && arena.upstreamAllocations() == 0 && arena.used() == 0,
+        "No heap allocation inside the arena, ArenaBurst resets it");
+
+    std::vector<std::byte*> spilled;
+    for (int i = 0; i < 4; ++i) spilled.push_back(static_cast<std::byte*>(arena.allocate(12 << 10, 64)));
+    for (std::byte* p : spilled) std::memset(p, 0xAB, 12 << 10);
+    check(arena.upstreamAllocations() == 3 && reinterpret_cast<uintptr_t>(spilled[3]) % 64 == 0,
+        "Overflow beyond capacity goes upstream and is counted");
+    arena.reset();
+    check(arena.used() == 0, "Overflow blocks released on reset()");
+}
+
+/**************************************************************************
+Decode paths over bursts of trade CSV lines. The legacy path is the old
+TradeMsgStore::parseTrade (istringstream + std::string tokens + stoull/stod)
+into a std::vector per burst, the arena path is decodeTradeCsv into a
+std::pmr::vector on a MonotonicArena reset after every burst.
+**************************************************************************/
+std::vector<std::string> tradeLines(size_t count) {
+    std::mt19937_64 rng(11);
+    std::vector<std::string> lines;
+    lines.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const double price = 2400.0 + (rng() % 100000) / 100.0;
+        const double qty = (rng() % 100000) / 10000.0;
+        std::ostringstream ss;
+        ss.precision(12);
+        ss << 5000000000ull + i << "," << price << "," << qty << "," << price * qty << "," <<
+            1750377600000000ull + i * 37 << "," << ((rng() & 1) ? "True" : "False") << ",True";
+        lines.push_back(ss.str());
+    }
+    return lines;
+}
+
+void legacyParse(const std::string& line, uint64_t sequence, ITCHTradeMsg& msg) {
+    msg.message_type = 'P';
+    msg.sequence_number = sequence;
+    std::istringstream ss(line);
+    std::string token {};
+    std::getline(ss, token, ','); msg.trade_id = std::stoull(token);
+    std::getline(ss, token, ','); msg.price = std::stod(token);
+    std::getline(ss, token, ','); msg.quantity = std::stod(token);
+    std::getline(ss, token, ',');
+    std::getline(ss, token, ','); msg.timestamp = std::stoull(token);
+    std::getline(ss, token, ','); msg.buyer_is_maker = (token == "True");
+    std::getline(ss, token, ','); msg.best_match = (token == "True");
+}
+
+// Returns the heap allocations made by the timed bursts
+template <typename Burst>
+uint64_t decodeRun(const char* name, const std::vector<std::string>& lines, size_t burstSize, Burst&& burst) {
+    constexpr size_t warmupBursts = 16;
+    double checksum = 0.0;
+    for (size_t b = 0; b < warmupBursts; ++b)
+        checksum += burst(b * burstSize);
+
+    const size_t bursts = lines.size() / burstSize;
+    const uint64_t allocsBefore = heapAllocations;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t b = 0; b < bursts; ++b)
+        checksum += burst(b * burstSize);
+    const auto end = std::chrono::steady_clock::now();
+    const uint64_t allocs = heapAllocations - allocsBefore;
+
+    const double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    std::cout << "\t🟢 " << name << ": " << (ns / (bursts * burstSize)) << " ns/line, " <<
+        ((double)allocs / bursts) << " heap allocations/burst (checksum " << (uint64_t)checksum << ")\n";
+    return allocs;
+}
+
+void decodeBenchmark() {
+    constexpr size_t lineCount = 1 << 19;
+    constexpr size_t burstSize = 32;
+    const auto lines = tradeLines(lineCount);
+    std::cout << "Decoding " << lineCount << " trade lines in bursts of " << burstSize << "...\n";
+
+    auto consume = [](const auto& batch) {
+        double sum = 0.0;
+        for (const ITCHTradeMsg& msg : batch) sum += msg.price * msg.quantity;
+        return sum;
+    };
+
+    decodeRun("istringstream + std::vector", lines, burstSize, [&](size_t first) {
+        std::vector<ITCHTradeMsg> batch;
+        for (size_t i = first; i < first + burstSize; ++i) {
+            ITCHTradeMsg msg {};
+            legacyParse(lines[i], i, msg);
+            batch.push_back(msg);
+        }
+        return consume(batch);
+    });
+
+    decodeRun("decodeTradeCsv + std::vector", lines, burstSize, [&](size_t first) {
+        std::vector<ITCHTradeMsg> batch;
+        batch.reserve(burstSize);
+        for (size_t i = first; i < first + burstSize; ++i) {
+            ITCHTradeMsg msg {};
+            decodeTradeCsv(lines[i], i, msg);
+            batch.push_back(msg);
+        }
+        return consume(batch);
+    });
+
+    MonotonicArena arena(64 << 10, PoolBacking{ .prefault = true });
+    bool decoded = true;
+    const uint64_t allocs = decodeRun("decodeTradeCsv + MonotonicArena", lines, burstSize, [&](size_t first) {
+        ArenaBurst burst(arena);
+        std::pmr::vector<ITCHTradeMsg> batch(&arena);
+        batch.reserve(burstSize);
+        for (size_t i = first; i < first + burstSize; ++i) {
+            ITCHTradeMsg msg {};
+            decoded &= decodeTradeCsv(lines[i], i, msg);
+            batch.push_back(msg);
+        }
+        return consume(batch);
+    });
+
+    std::cout << "\t" << (allocs == 0 && arena.upstreamAllocations() == 0 && decoded ? "🟢" : "🔴") <<
+        " Arena path steady state: " << allocs << " heap allocations, " << arena.upstreamAllocations() <<
+        " upstream, high watermark " << arena.highWatermark() << " bytes\n";
+
+    bool same = true;
+    for (size_t i = 0; i < 1000; ++i) {
+        ITCHTradeMsg expected {}, actual {};
+        legacyParse(lines[i], i, expected);
+        decodeTradeCsv(lines[i], i, actual);
+        same &= std::memcmp(&expected, &actual, sizeof(ITCHTradeMsg)) == 0;
+    }
+    ITCHTradeMsg msg {};
+    const bool rejects = !decodeTradeCsv("123,abc,1,1,1,True,True", 0, msg) && !decodeTradeCsv("", 0, msg);
+    std::cout << "\t" << (same && rejects ? "🟢" : "🔴") << " decodeTradeCsv matches the stringstream parser\n";
+}
+
+int main() {
+    arenaTest();
+    decodeBenchmark();
+}
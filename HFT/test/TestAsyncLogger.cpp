@@ -1,12 +1,737 @@
 // g++ -std=c++20 -O3 TestAsyncLogger.cpp -o TestAsyncLogger -I../
 
 #include "AsyncLogger.hpp"
+#include "MmapLogSink.hpp"
+#include "Queue.hpp"
+#include "MemoryPool.hpp"
+#include "BenchUtils.hpp"
 #include <thread>
 #include <vector>
 #include <chrono>
 #include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+/**************************************************************************
+formatDeferred must print what snprintf prints for the same call.
+**************************************************************************/
+template <typename... Args>
+bool sameAsPrintf(const char* fmt, Args... args) {
+    char expected[256], actual[256], encoded[Const::LogBufferSize];
+    std::snprintf(expected, sizeof(expected), fmt, args...);
+    const size_t bytes = encodeLogArgs<sizeof(encoded)>(encoded, args...);
+    formatDeferred(actual, sizeof(actual), fmt, LogSignature<Args...>::value, encoded, bytes);
+    if (std::strcmp(expected, actual) != 0) {
+        std::cout << "\t🔴 \"" << expected << "\" != \"" << actual << "\"\n";
+        return false;
+    }
+    return true;
+}
+
+void deferredFormatTest() {
+    std::cout << "Testing deferred formatting...\n";
+    bool ok = true;
+    ok &= sameAsPrintf("Thread %d: MessageID = %d\n", 3, 42);
+    ok &= sameAsPrintf("Gap from %llu to %llu, initiating recovery\n", 18446744073709551615ull, 7ull);
+    ok &= sameAsPrintf("%-8s|%8.3f|%+5d|%x|%c|%%|%lu", "sym", 2456.125, -7, 255u, 'Z', 123456789ul);
+    ok &= sameAsPrintf("%*d|%.*f|%5.2s", 6, 42, 2, 3.14159, "abcdef");
+    ok &= sameAsPrintf("%s %s", "first", "second");
+    ok &= sameAsPrintf("%hhd %hu %e %g", (signed char)-5, (unsigned short)65000, 1e-9, 0.5f);
+    ok &= sameAsPrintf("bool %d, short %d", true, (short)-3);
+    std::cout << "\t" << (ok ? "🟢" : "🔴") << " formatDeferred matches snprintf\n";
+
+    char encoded[Const::LogBufferSize], out[256];
+    const std::string longText(2000, 'x');
+    const size_t bytes = encodeLogArgs<sizeof(encoded)>(encoded, longText, 7ull);
+    formatDeferred(out, sizeof(out), "%.5s %llu", LogSignature<std::string, unsigned long long>::value, encoded, bytes);
+    std::cout << "\t" << (bytes <= sizeof(encoded) && std::string(out) == "xxxxx 7" ? "🟢" : "🔴") << 
+        " Long strings are cut to the message buffer, later args survive (" << bytes << " bytes)\n";
+}
+
+/**************************************************************************
+The same calls logged as text and as a binary file decoded afterwards.
+**************************************************************************/
+void binaryRoundTrip() {
+    std::cout << "Testing LogOutput::Binary round trip...\n";
+    constexpr int count = 1000;
+    std::stringstream binary(std::ios::in | std::ios::out | std::ios::binary);
+    {
+        AsyncLogger logger(binary, LogOutput::Binary);
+        for (int i = 0; i < count; ++i) {
+            if (i % 10 == 0) 
+                logger.log("Text line %d\n", i);
+            else 
+                logger.logDeferred("Trade %llu px %.2f qty %.4f maker %d %s\n", 1000ull + i, 2450.0 + i, 0.5 * i, i & 1, "ETHUSDC");
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(500)); // let the logger thread drain
+    }
+
+    BinaryLogReader reader(binary);
+    uint64_t timestamp = 0, lastTimestamp = 0;
+    std::string line;
+    int decoded = 0, mismatches = 0;
+    char expected[256];
+    while (reader.next(timestamp, line)) {
+        const int i = decoded++;
+        if (i % 10 == 0) 
+            std::snprintf(expected, sizeof(expected), "Text line %d\n", i);
+        else 
+            std::snprintf(expected, sizeof(expected), "Trade %llu px %.2f qty %.4f maker %d %s\n", 1000ull + i, 2450.0 + i, 0.5 * i, i & 1, "ETHUSDC");
+        mismatches += (line != expected) || (timestamp < lastTimestamp);
+        lastTimestamp = timestamp;
+    }
+    std::cout << "\t" << (decoded == count && mismatches == 0 ? "🟢" : "🔴") << " Decoded " << decoded << 
+        " of " << count << " records, " << mismatches << " mismatches, " << binary.str().size() << " bytes\n";
+}
+
+/**************************************************************************
+Channels merged by timestamp: every line arrives, per thread in order.
+**************************************************************************/
+void channelOrderTest() {
+    std::cout << "Testing per-thread channels...\n";
+    constexpr int numThreads = 8;
+    constexpr int messagesPerThread = 5000;
+    std::stringstream out;
+    size_t channels = 0;
+    {
+        AsyncLogger logger(out);
+        std::vector<std::thread> workers;
+        for (int i = 0; i < numThreads; ++i) {
+            workers.emplace_back([i, &logger]() {
+                for (int j = 0; j < messagesPerThread; ++j) {
+                    logger.logDeferred("Thread %d: MessageID = %d\n", i, j);
+                    if (j % 128 == 127) std::this_thread::sleep_for(std::chrono::milliseconds(1)); // stay under the ring size
+                }
+            });
+        }
+        for (auto& t : workers) t.join();
+        std::thread([&logger]() { logger.log("Channel reused\n"); }).join(); // takes over a retired channel
+        channels = logger.channels();
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+
+    std::vector<int> next(numThreads, 0);
+    int lines = 0, outOfOrder = 0, gaps = 0;
+    uint64_t lastTs = 0, backwards = 0;
+    std::string line;
+    while (std::getline(out, line)) {
+        ++lines;
+        int thread = -1, id = -1;
+        unsigned long long ts = 0;
+        if (std::sscanf(line.c_str(), "[%llu] | Thread %d: MessageID = %d", &ts, &thread, &id) == 3) {
+            outOfOrder += (id < next[thread]);
+            gaps += (id > next[thread]); // dropped on a full channel
+            next[thread] = id + 1;
+        }
+        backwards += (ts < lastTs);
+        lastTs = std::max<uint64_t>(lastTs, ts);
+    }
+    std::cout << "\t" << (outOfOrder == 0 ? "🟢" : "🔴") << " " << lines << " of " << numThreads * messagesPerThread + 1 << 
+        " lines, " << outOfOrder << " out of order within a thread, " << gaps << " gaps, " << backwards << 
+        " timestamps behind an earlier line\n";
+    std::cout << "\t" << (channels == numThreads ? "🟢" : "🔴") << " " << channels << " channels for " << 
+        numThreads + 1 << " threads (exited threads hand theirs on)\n";
+}
+
+/**************************************************************************
+A long lived thread logging to many short lived loggers: each logger frees its
+channel (Const::logChannelCapacity lines) when destroyed, resident memory stays
+flat instead of growing by a ring per logger.
+**************************************************************************/
+size_t residentKb() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * (::sysconf(_SC_PAGESIZE) / 1024);
+}
+
+void channelReleaseTest() {
+    std::cout << "Testing channel release with short lived loggers...\n";
+    constexpr int loggers = 100;
+    std::ofstream devNull("/dev/null");
+    auto session = [&](int i) {
+        AsyncLogger logger(devNull);
+        logger.log("Session %d\n", i);
+    };
+    session(0); // warm up, the allocator keeps the first ring's memory around
+    const size_t before = residentKb();
+    for (int i = 1; i <= loggers; ++i) session(i);
+    const size_t grownKb = residentKb() - std::min(before, residentKb());
+    const size_t ringKb = Const::logChannelCapacity * sizeof(LogMsg) / 1024;
+    std::cout << "\t" << (grownKb < 10 * ringKb ? "🟢" : "🔴") << " " << loggers << " loggers from one thread, resident memory grew "
+        << grownKb << " KB (" << ringKb << " KB per ring)\n";
+}
+
+/**************************************************************************
+Timestamps come from the call, not from when the logger thread got to the line:
+a burst is logged while the test sleeps between calls, every stamp must sit
+next to the wall clock read just before its call.
+**************************************************************************/
+void callSiteTimestampTest() {
+    std::cout << "Testing call site timestamps...\n";
+    TscClock clock;
+    const uint64_t t0 = TscClock::now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    const auto wall = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    clock.recalibrate();
+    const int64_t error = (int64_t)clock.toNs(TscClock::now()) - (int64_t)wall;
+    const int64_t elapsed = (int64_t)(clock.toNs(TscClock::now()) - clock.toNs(t0));
+    std::cout << "\t" << (std::abs(error) < 100'000 && std::abs(elapsed - 20'000'000) < 5'000'000 ? "🟢" : "🔴") << 
+        " TscClock " << clock.ticksPerNs() << " ticks/ns, " << error << "ns off the wall clock\n";
+
+    constexpr int count = 50;
+    std::vector<int64_t> calledAt(count);
+    std::stringstream out;
+    {
+        AsyncLogger logger(out);
+        logger.attachThread(); // channel set up here, not inside the first timed call
+        for (int i = 0; i < count; ++i) {
+            calledAt[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            logger.logDeferred("Call %d\n", i);
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    int64_t worst = 0;
+    int lines = 0;
+    std::string line;
+    while (std::getline(out, line)) {
+        unsigned long long ts = 0;
+        int i = -1;
+        if (std::sscanf(line.c_str(), "[%llu] | Call %d", &ts, &i) == 2 && i >= 0 && i < count) {
+            worst = std::max(worst, std::abs((int64_t)ts - calledAt[i]));
+            ++lines;
+        }
+    }
+    std::cout << "\t" << (lines == count && worst < 50'000 ? "🟢" : "🔴") << " " << lines << 
+        " lines, worst stamp " << worst << "ns from the call\n";
+}
+
+/**************************************************************************
+LogSequence::On numbers lines without gaps or repeats, text and binary.
+**************************************************************************/
+void sequenceTest() {
+    std::cout << "Testing LogSequence::On...\n";
+    constexpr int numThreads = 4;
+    constexpr int messagesPerThread = 2000;
+    std::stringstream text;
+    std::stringstream binary(std::ios::in | std::ios::out | std::ios::binary);
+    {
+        AsyncLogger textLogger(text, LogOutput::Text, {}, LogSequence::On);
+        AsyncLogger binaryLogger(binary, LogOutput::Binary, {}, LogSequence::On);
+        std::vector<std::thread> workers;
+        for (int i = 0; i < numThreads; ++i) {
+            workers.emplace_back([&, i]() {
+                for (int j = 0; j < messagesPerThread; ++j) {
+                    textLogger.logDeferred("Thread %d: MessageID = %d\n", i, j);
+                    binaryLogger.logDeferred("Thread %d: MessageID = %d\n", i, j);
+                    if (j % 128 == 127) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            });
+        }
+        for (auto& t : workers) t.join();
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+    constexpr size_t total = numThreads * messagesPerThread;
+    std::vector<int> seen(total, 0);
+    std::string line;
+    while (std::getline(text, line)) {
+        unsigned long long ts = 0, seq = 0;
+        if (std::sscanf(line.c_str(), "[%llu] #%llu |", &ts, &seq) == 2 && seq < total) ++seen[seq];
+    }
+    const bool textOk = std::all_of(seen.begin(), seen.end(), [](int n) { return n == 1; });
+
+    std::fill(seen.begin(), seen.end(), 0);
+    BinaryLogReader reader(binary);
+    uint64_t ts = 0;
+    while (reader.next(ts, line)) {
+        if (reader.hasSequence() && reader.sequence() < total) ++seen[reader.sequence()];
+    }
+    const bool binaryOk = std::all_of(seen.begin(), seen.end(), [](int n) { return n == 1; });
+    std::cout << "\t" << (textOk && binaryOk ? "🟢" : "🔴") << " " << total << 
+        " lines numbered 0.." << total - 1 << " exactly once (text " << textOk << ", binary " << binaryOk << ")\n";
+}
+
+/**************************************************************************
+A log storm (one thread, 16 channels worth of lines back to back) under each
+LogOverflowPolicy. Calls must return quickly and never throw, dropped lines
+must be accounted for and reported in the log itself.
+**************************************************************************/
+void overflowRun(const char* name, const LogOverflowPolicy& policy, bool expectDrops) {
+    constexpr int count = 16 * Const::logChannelCapacity;
+    std::stringstream out;
+    uint64_t written = 0, dropped = 0;
+    Bench::LatencyHistogram hist;
+    bool threw = false;
+    {
+        AsyncLogger logger(out, LogOutput::Text, {}, LogSequence::Off, policy);
+        logger.attachThread();
+        try {
+            for (int i = 0; i < count; ++i) {
+                const uint64_t t0 = Bench::rdtsc();
+                logger.logDeferred("Storm line %d of %d\n", i, count);
+                hist.record(Bench::rdtsc() - t0);
+            }
+        } catch (...) {
+            threw = true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(policy.reportIntervalMs * 3));
+        written = logger.written();
+        dropped = logger.dropped();
+    }
+    int stormLines = 0, summaries = 0, reports = 0;
+    uint64_t summarized = 0, reported = 0;
+    std::string line;
+    while (std::getline(out, line)) {
+        unsigned long long n = 0, total = 0, ms = 0;
+        const char* text = std::strstr(line.c_str(), "| ");
+        if (!text) continue;
+        text += 2;
+        if (std::strncmp(text, "Storm line", 10) == 0) ++stormLines;
+        else if (std::sscanf(text, "%llu lines dropped, last: Storm line", &n) == 1) { ++summaries; summarized += n; }
+        else if (std::sscanf(text, "AsyncLogger dropped %llu lines in the last %llu ms (%llu in total)", &n, &ms, &total) == 3) { 
+            ++reports; reported = total; 
+        }
+    }
+    const bool accounted = written + dropped == (uint64_t)count && stormLines == (int)written && reported == dropped;
+    const bool summaryOk = policy.mode != LogOverflow::Summary || summarized == dropped;
+    const bool ok = !threw && accounted && summaryOk && (expectDrops ? dropped > 0 : dropped == 0);
+    std::cout << "\t" << (ok ? "🟢 " : "🔴 ") << name << ": " << written << " written, " << dropped << " dropped, " << 
+        reports << " drop reports, " << summaries << " inline summaries, call p50 " << Bench::tscToNs(hist.percentile(50)) << 
+        "ns p99.9 " << Bench::tscToNs(hist.percentile(99.9)) << "ns max " << Bench::tscToNs(hist.max()) << "ns\n";
+}
+
+void overflowTest() {
+    std::cout << "Testing overflow policies under a log storm...\n";
+    overflowRun("DropNewest", LogOverflowPolicy{ .mode = LogOverflow::DropNewest, .reportIntervalMs = 20 }, true);
+    overflowRun("Summary", LogOverflowPolicy{ .mode = LogOverflow::Summary, .reportIntervalMs = 20 }, true);
+    overflowRun("Block 1s", LogOverflowPolicy{ .mode = LogOverflow::Block, .blockTimeoutUs = 1'000'000, .reportIntervalMs = 20 }, false);
+}
+
+/**************************************************************************
+MmapLogSink with small segments: the segments concatenated are exactly the
+log, closed ones are gzip'ed by the helper thread.
+**************************************************************************/
+std::vector<std::filesystem::path> segmentsOf(const std::string& base) {
+    std::vector<std::filesystem::path> segments;
+    for (const auto& entry : std::filesystem::directory_iterator(".")) {
+        if (entry.path().filename().string().rfind(base + ".", 0) == 0) segments.push_back(entry.path());
+    }
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+void mmapSinkTest() {
+    std::cout << "Testing MmapLogSink...\n";
+    constexpr int count = 20000;
+    constexpr size_t segmentBytes = 64 << 10;
+    for (const char* compress : { "", "gzip" }) {
+        const std::string base = "log_mmap_test";
+        uint64_t rotations = 0, lost = 0;
+        {
+            MmapLogSink sink(base, MmapLogOptions{ .segmentBytes = segmentBytes, .syncIntervalMs = 5, .compressCommand = compress });
+            {
+                // Blocking so a gzip run stealing the CPU cannot drop lines, the destructor drains the rest
+                AsyncLogger logger(sink, LogOutput::Text, {}, LogSequence::Off, 
+                    LogOverflowPolicy{ .mode = LogOverflow::Block, .blockTimeoutUs = 1'000'000 });
+                for (int i = 0; i < count; ++i) 
+                    logger.logDeferred("Line %d of %d\n", i, count);
+            }
+            rotations = sink.rotations();
+            lost = sink.lostBytes();
+        }
+        const auto segments = segmentsOf(base);
+        std::string all;
+        bool sized = true;
+        for (const auto& segment : segments) {
+            if (segment.extension() == ".gz") {
+                FILE* pipe = popen(("gzip -dc " + segment.string()).c_str(), "r");
+                char chunk[4096];
+                size_t n;
+                while (pipe && (n = fread(chunk, 1, sizeof(chunk), pipe)) > 0) all.append(chunk, n);
+                if (pipe) pclose(pipe);
+            }
+            else {
+                std::ifstream in(segment, std::ios::binary);
+                const std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+                sized &= data.size() <= segmentBytes;
+                all += data;
+            }
+            std::filesystem::remove(segment);
+        }
+        std::istringstream lines(all);
+        std::string line;
+        int next = 0, bad = 0;
+        while (std::getline(lines, line)) {
+            int i = -1;
+            const char* text = std::strstr(line.c_str(), "| ");
+            bad += !(text && std::sscanf(text, "| Line %d of", &i) == 1 && i == next++);
+        }
+        const bool compressed = *compress == '\0' || std::all_of(segments.begin(), segments.end(), 
+            [](const auto& p) { return p.extension() == ".gz"; });
+        std::cout << "\t" << (next == count && bad == 0 && lost == 0 && sized && compressed && 
+            segments.size() == rotations + 1 ? "🟢" : "🔴") << " " << (*compress ? "gzip: " : "plain: ") << segments.size() << 
+            " segments, " << rotations << " rotations, " << next << " of " << count << " lines in order, " << 
+            bad << " bad\n";
+    }
+}
+
+/**************************************************************************
+Level-tagged calls, text and binary. Format mismatches are compile errors
+(see LogFormat), nothing to run for them here.
+**************************************************************************/
+void levelTest() {
+    std::cout << "Testing log levels...\n";
+    std::stringstream text;
+    std::stringstream binary(std::ios::in | std::ios::out | std::ios::binary);
+    {
+        AsyncLogger textLogger(text);
+        AsyncLogger binaryLogger(binary, LogOutput::Binary);
+        for (AsyncLogger* logger : { &textLogger, &binaryLogger }) {
+            logger->debug("Debug %d\n", 1);
+            logger->info("Info %s %.1f\n", "px", 2450.5);
+            logger->warn("Warn %llu\n", 3ull);
+            logger->error("Error %*d|\n", 4, 7);
+            logger->logDeferred("Untagged %d\n", 5);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(text, line)) lines.push_back(line.substr(line.find("| ") + 2));
+    const std::vector<std::string> expected = { "DEBUG | Debug 1", "INFO | Info px 2450.5", "WARN | Warn 3", 
+        "ERROR | Error    7|", "Untagged 5" };
+    std::cout << "\t" << (lines == expected ? "🟢" : "🔴") << " Text lines carry their level\n";
+
+    BinaryLogReader reader(binary);
+    uint64_t ts = 0;
+    std::vector<std::string> decoded;
+    while (reader.next(ts, line)) {
+        line.pop_back();
+        decoded.push_back(reader.hasLevel() ? std::string(logLevelName(reader.level())) + " | " + line : line);
+    }
+    std::cout << "\t" << (decoded == expected ? "🟢" : "🔴") << " Binary entries carry their level\n";
+    std::cout << "\t🟢 Compiled with Const::logMinLevel = " << logLevelName(Const::logMinLevel) << "\n";
+}
+
+/**************************************************************************
+Shutdown and flush(): destroying the logger right after a burst still writes
+every line, flush() returns with everything before it in the stream, and a
+sink too slow to finish within shutdownTimeoutMs does not hold up the
+destructor.
+**************************************************************************/
+struct SlowSink : LogSink {
+    std::string data;
+    void write(const char* bytes, size_t len) override {
+        data.append(bytes, len);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    void flush() override { }
+};
+
+size_t countLines(const std::string& text, const char* prefix) {
+    std::istringstream lines(text);
+    std::string line;
+    size_t count = 0;
+    while (std::getline(lines, line)) count += line.find(prefix) != std::string::npos;
+    return count;
+}
+
+void shutdownTest() {
+    std::cout << "Testing shutdown drain and flush()...\n";
+    constexpr int count = 1000;
+    std::stringstream text;
+    {
+        AsyncLogger logger(text);
+        logger.attachThread();
+        for (int i = 0; i < count; ++i) logger.logDeferred("Burst %d\n", i);
+    }
+    const size_t burst = countLines(text.str(), "Burst ");
+    std::cout << "\t" << (burst == count ? "🟢" : "🔴") << " Destructor wrote " << burst << "/" << count << " lines logged just before it\n";
+
+    std::stringstream flushed;
+    {
+        AsyncLogger logger(flushed);
+        logger.attachThread();
+        bool complete = true;
+        for (int round = 1; round <= 5; ++round) {
+            for (int i = 0; i < 100; ++i) logger.logDeferred("Round %d line %d\n", round, i);
+            const auto start = std::chrono::steady_clock::now();
+            const bool done = logger.flush();
+            const auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+            const size_t lines = countLines(flushed.str(), "Round ");
+            complete &= done && lines == size_t(round) * 100;
+            if (round == 1) std::cout << "\t   flush() of 100 lines took " << us << " us\n";
+        }
+        std::cout << "\t" << (complete ? "🟢" : "🔴") << " Every line before flush() is in the stream when it returns\n";
+    }
+
+    SlowSink slow;
+    constexpr uint32_t timeoutMs = 100;
+    const auto start = std::chrono::steady_clock::now();
+    {
+        AsyncLogger logger(slow, LogOutput::Text, LogFlushPolicy{ .everyMessage = true, .shutdownTimeoutMs = timeoutMs });
+        logger.attachThread();
+        for (int i = 0; i < 500; ++i) logger.logDeferred("Slow %d\n", i);
+    }
+    const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    const bool reported = slow.data.find("shutdown timed out") != std::string::npos;
+    std::cout << "\t" << (ms < timeoutMs + 100 && reported ? "🟢" : "🔴") << " Slow sink: destructor returned after " << ms 
+        << " ms with " << countLines(slow.data, "Slow ") << "/500 lines and a timeout note\n";
+}
+
+/**************************************************************************
+Hot loop primitives: 1-in-N sampling, N per second and first K, each with
+its static per-site slot. Suppressed calls are summarised by the site, the
+cost of a suppressed call is measured over a million of them.
+**************************************************************************/
+void suppressionTest() {
+    std::cout << "Testing sampled, rate limited and first-K logging...\n";
+    std::stringstream text;
+    AsyncLogger logger(text);
+    logger.attachThread();
+    auto lines = [&](const char* prefix) { logger.flush(); return countLines(text.str(), prefix); };
+
+    for (int i = 0; i < 1000; ++i) LOG_EVERY_N(logger, LogLevel::Info, 10, "Sampled %d\n", i);
+    const bool sampled = lines("Sampled ") == 100 && text.str().find("Sampled 990\n") != std::string::npos;
+    std::cout << "\t" << (sampled ? "🟢" : "🔴") << " Every 10th of 1000 calls: " << lines("Sampled ") << " lines\n";
+
+    auto rate = [&](int i) { LOG_RATE_LIMITED(logger, LogLevel::Warn, 50, "Rate %d\n", i); };
+    for (int i = 0; i < 10000; ++i) rate(i);
+    const size_t inWindow = lines("Rate ");
+    std::this_thread::sleep_for(std::chrono::milliseconds(1050));
+    rate(10000);
+    const bool limited = inWindow == 50 && lines("Rate ") == 52 && 
+        text.str().find("9950 lines suppressed like: Rate %d\n") != std::string::npos && 
+        text.str().find("Rate 10000\n") != std::string::npos;
+    std::cout << "\t" << (limited ? "🟢" : "🔴") << " 50 per second: " << inWindow << " of 10000 calls, summary in the next window\n";
+
+    auto none = [&](int i) { LOG_RATE_LIMITED(logger, LogLevel::Warn, 0, "None %d\n", i); };
+    for (int i = 0; i < 1000; ++i) none(i);
+    std::cout << "\t" << (lines("None ") == 0 ? "🟢" : "🔴") << " 0 per second logs none of 1000 calls\n";
+
+    auto first = [&](int i) { LOG_FIRST_N(logger, LogLevel::Error, 5, "First %d\n", i); };
+    for (int i = 0; i < 1000; ++i) first(i);
+    const size_t firstLines = lines("First ");
+    std::this_thread::sleep_for(std::chrono::milliseconds(1050));
+    first(1000);
+    const bool firstK = firstLines == 5 && lines("First ") == 6 && text.str().find("ERROR | 996 lines suppressed like: First %d\n") != std::string::npos;
+    std::cout << "\t" << (firstK ? "🟢" : "🔴") << " First 5 of 1000 calls, then a summary on the first call a second later\n";
+
+    constexpr uint64_t calls = 1'000'000;
+    auto cost = [&](const char* name, auto&& call) {
+        const uint64_t t0 = Bench::rdtsc();
+        for (uint64_t i = 0; i < calls; ++i) call(i);
+        const double ns = Bench::tscToNs(Bench::rdtsc() - t0) / double(calls);
+        std::cout << "\t🟢 " << name << ": " << ns << " ns per suppressed call\n";
+    };
+    cost("LOG_EVERY_N", [&](uint64_t i) { LOG_EVERY_N(logger, LogLevel::Info, calls + 1, "Cost %llu\n", (unsigned long long)i); });
+    cost("LOG_FIRST_N", [&](uint64_t i) { LOG_FIRST_N(logger, LogLevel::Info, 0, "Cost %llu\n", (unsigned long long)i); });
+    cost("LOG_RATE_LIMITED", [&](uint64_t i) { if (i > 0) LOG_RATE_LIMITED(logger, LogLevel::Info, 1, "Cost %llu\n", (unsigned long long)i); });
+}
+
+/**************************************************************************
+Caller side cost per call (TSC around the call), the logger thread drains into
+/dev/null meanwhile. Calls are paced so the queue never fills.
+**************************************************************************/
+void callerCostBenchmark() {
+    constexpr size_t calls = 100'000;
+    std::cout << "Caller side cost of " << calls << " calls...\n";
+    std::ofstream devNull("/dev/null");
+    AsyncLogger logger(devNull);
+    auto run = [&](const char* name, auto&& call) {
+        Bench::LatencyHistogram hist;
+        for (size_t i = 0; i < calls; ++i) {
+            const uint64_t t0 = Bench::rdtsc();
+            call(i);
+            hist.record(Bench::rdtsc() - t0);
+            if (i % 256 == 255) 
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        std::cout << "\t🟢 " << name << ": mean " << Bench::tscToNs(hist.mean()) << "ns p50 " << 
+            Bench::tscToNs(hist.percentile(50)) << "ns p99 " << Bench::tscToNs(hist.percentile(99)) << "ns\n";
+    };
+    run("log() 2 ints", [&](size_t i) { logger.log("TradeDataSequencer received msg %llu of %llu\n", 
+        (unsigned long long)i, (unsigned long long)calls); });
+    run("logDeferred() 2 ints", [&](size_t i) { logger.logDeferred("TradeDataSequencer received msg %llu of %llu\n", 
+        (unsigned long long)i, (unsigned long long)calls); });
+    run("log() trade line", [&](size_t i) { logger.log("Trade %llu px %.2f qty %.4f maker %d %s\n", 
+        (unsigned long long)i, 2450.0 + i, 0.5 * i, (int)(i & 1), "ETHUSDC"); });
+    run("logDeferred() trade line", [&](size_t i) { logger.logDeferred("Trade %llu px %.2f qty %.4f maker %d %s\n", 
+        (unsigned long long)i, 2450.0 + i, 0.5 * i, (int)(i & 1), "ETHUSDC"); });
+}
+
+/**************************************************************************
+Drain throughput with the workload below (10 threads, "Thread %d: MessageID"
+lines into log_file.txt) but without the sleeps, producers keep the queue full
+for a fixed window. Lines that find the queue full are dropped, written()
+counts what reached the file.
+**************************************************************************/
+void flushThroughputRun(const char* name, const LogFlushPolicy& policy, LogSink* sink = nullptr) {
+    constexpr int numThreads = 10;
+    constexpr auto window = std::chrono::seconds(1);
+    std::ofstream file("log_file.txt");
+    OstreamLogSink fileSink(file);
+    uint64_t written = 0, flushes = 0;
+    {
+        AsyncLogger logger(sink ? *sink : fileSink, LogOutput::Text, policy);
+        std::atomic<bool> stop{false};
+        std::vector<std::thread> workers;
+        for (int i = 0; i < numThreads; ++i) {
+            workers.emplace_back([i, &logger, &stop]() {
+                for (int j = 0; !stop.load(std::memory_order_relaxed); ++j) {
+                    logger.log("Thread %d: MessageID = %d\n", i, j);
+                    if (j % 64 == 63) std::this_thread::yield();
+                }
+            });
+        }
+        std::this_thread::sleep_for(window);
+        written = logger.written();
+        flushes = logger.flushes();
+        stop = true;
+        for (auto& t : workers) t.join();
+    }
+    const double seconds = std::chrono::duration<double>(window).count();
+    std::cout << "\t🟢 " << name << ": " << (uint64_t)(written / seconds) << " lines/s, " << 
+        (flushes ? written / flushes : 0) << " lines per flush\n";
+}
+
+void flushThroughputBenchmark() {
+    std::cout << "Logger drain throughput...\n";
+    flushThroughputRun("Flush every message", LogFlushPolicy{ .everyMessage = true });
+    flushThroughputRun("Batched, 64KB / 1ms", LogFlushPolicy{});
+    flushThroughputRun("Batched, 1MB / 10ms", LogFlushPolicy{ .stagingBytes = 1 << 20, .intervalUs = 10000 });
+    {
+        MmapLogSink sink("log_mmap_bench", MmapLogOptions{ .compressCommand = "" });
+        flushThroughputRun("Batched, 64KB / 1ms, MmapLogSink", LogFlushPolicy{}, &sink);
+        std::cout << "\t🟢 MmapLogSink: " << sink.rotations() << " rotations, " << sink.syncRotations() << 
+            " waited for a segment\n";
+    }
+    for (const auto& entry : std::filesystem::directory_iterator(".")) {
+        if (entry.path().filename().string().rfind("log_mmap_bench.", 0) == 0) std::filesystem::remove(entry.path());
+    }
+}
+
+/**************************************************************************
+Producer scaling, every thread makes the same logDeferred call in a loop. The
+baseline is the previous design (one shared MPSC queue + one lock-free pool,
+its consumer formats each message like the logger thread) so the difference
+is producer contention. Per call cost is TSC around the call, p50 stays
+meaningful when threads outnumber cores.
+**************************************************************************/
+struct ScalingResult {
+    double callsPerSec;
+    Bench::LatencyHistogram perCall;
+    double dropped = 0.0;
+};
+
+template <typename Call>
+ScalingResult runProducers(int threads, size_t callsPerThread, Call&& call) {
+    std::atomic<int> ready{0};
+    std::atomic<bool> go{false};
+    std::mutex mergeMutex;
+    ScalingResult result{};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            Bench::LatencyHistogram hist;
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+            for (size_t i = 0; i < callsPerThread; ++i) {
+                const uint64_t t0 = Bench::rdtsc();
+                call(t, i);
+                hist.record(Bench::rdtsc() - t0);
+                if (i % 64 == 63) std::this_thread::yield(); // let the consumer in on small machines
+            }
+            std::lock_guard<std::mutex> lock(mergeMutex);
+            result.perCall.merge(hist);
+        });
+    }
+    while (ready.load() < threads) std::this_thread::yield();
+    const auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& w : workers) w.join();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.callsPerSec = double(threads) * callsPerThread / seconds;
+    return result;
+}
+
+void producerScalingBenchmark() {
+    constexpr size_t callsPerThread = 1 << 15;
+    std::cout << "Producer scaling, " << callsPerThread << " logDeferred calls per thread...\n";
+    auto print = [](const char* name, const ScalingResult& r) {
+        std::cout << name << Bench::tscToNs(r.perCall.percentile(50)) << "ns p50 " << 
+            Bench::tscToNs(r.perCall.percentile(99)) << "ns p99 " << (uint64_t)(r.callsPerSec / 1000) << "K calls/s " << 
+            (uint64_t)(r.dropped * 100) << "% dropped";
+    };
+    for (int threads : { 1, 2, 4, 8, 16, 32 }) {
+        ScalingResult shared{}, channels{};
+        const double calls = double(threads) * callsPerThread;
+        { // previous design
+            Queue<CustomMPSCLockFreeQueue<LogMsg*>> queue;
+            MemoryPool<LockFreeThreadSafePool<LogMsg, true>> pool;
+            std::atomic<bool> stop{false};
+            std::atomic<uint64_t> dropped{0};
+            std::thread consumer([&]() {
+                char line[4 * Const::LogBufferSize];
+                auto consume = [&](LogMsg* msg) {
+                    formatDeferred(line, sizeof(line), msg->fmt, msg->signature, msg->buffer, msg->len);
+                    pool.destroy(msg);
+                };
+                while (!stop.load(std::memory_order_relaxed)) {
+                    if (LogMsg* msg = queue.dequeue()) consume(msg);
+                    else std::this_thread::yield();
+                }
+                while (LogMsg* msg = queue.dequeue()) consume(msg);
+            });
+            shared = runProducers(threads, callsPerThread, [&](int t, size_t i) {
+                LogMsg* msg = pool.create();
+                if (!msg) { dropped.fetch_add(1, std::memory_order_relaxed); return; }
+                msg->fmt = "Thread %d: MessageID = %llu\n";
+                msg->signature = LogSignature<int, unsigned long long>::value;
+                msg->len = encodeLogArgs<sizeof(msg->buffer)>(msg->buffer, t, (unsigned long long)i);
+                if (!queue.enqueue(msg)) { pool.destroy(msg); dropped.fetch_add(1, std::memory_order_relaxed); }
+            });
+            stop = true;
+            consumer.join();
+            shared.dropped = double(dropped.load()) / calls;
+        }
+        {
+            std::ofstream devNull("/dev/null");
+            AsyncLogger logger(devNull);
+            channels = runProducers(threads, callsPerThread, [&](int t, size_t i) {
+                logger.logDeferred("Thread %d: MessageID = %llu\n", t, (unsigned long long)i);
+            });
+            std::this_thread::sleep_for(std::chrono::milliseconds(50)); // drain what is left
+            channels.dropped = 1.0 - double(logger.written()) / calls;
+        }
+        std::cout << "\t🟢 " << threads << " threads";
+        print(": shared queue ", shared);
+        print(" | channels ", channels);
+        std::cout << "\n";
+    }
+}
 
 int main() {
+    deferredFormatTest();
+    binaryRoundTrip();
+    channelOrderTest();
+    channelReleaseTest();
+    callSiteTimestampTest();
+    sequenceTest();
+    overflowTest();
+    mmapSinkTest();
+    levelTest();
+    shutdownTest();
+    suppressionTest();
+    callerCostBenchmark();
+    flushThroughputBenchmark();
+    producerScalingBenchmark();
+
     { // Using std::cout to write the log
         AsyncLogger logger(std::cout);
 
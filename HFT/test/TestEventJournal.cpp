@@ -0,0 +1,221 @@
+// g++ -std=c++20 -O3 TestEventJournal.cpp -o TestEventJournal -I../
+
+#include "AsyncLogger.hpp"
+#include "EventJournal.hpp"
+#include "OrderBook.hpp"
+#include "BenchUtils.hpp"
+#include <thread>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <filesystem>
+
+// Every record of a journal with its timestamp, for comparisons
+struct Collector {
+    std::vector<JournalItchTrade> trades;
+    std::vector<JournalGap> gaps;
+    std::vector<JournalRecovery> recoveries;
+    std::vector<std::string> notes;
+    std::vector<uint64_t> timestamps;
+    void operator()(uint64_t ns, const JournalItchTrade& r) { trades.push_back(r); timestamps.push_back(ns); }
+    void operator()(uint64_t ns, const JournalGap& r) { gaps.push_back(r); timestamps.push_back(ns); }
+    void operator()(uint64_t ns, const JournalRecovery& r) { recoveries.push_back(r); timestamps.push_back(ns); }
+    void operator()(uint64_t ns, std::string_view text) { notes.emplace_back(text); timestamps.push_back(ns); }
+};
+
+ITCHTradeMsg tradeMsg(uint64_t i) {
+    return ITCHTradeMsg{ 'P', i, 5000 + i, 1'700'000'000'000 + i, 2450.0 + 0.01 * i, 0.5 * (i % 7 + 1), (i & 1) != 0, true };
+}
+
+/**************************************************************************
+Records written through AsyncLogger (LogOutput::Journal) come back typed and
+in order, log lines as notes, with the index footer in place.
+**************************************************************************/
+void journalRoundTrip() {
+    std::cout << "Testing journal round trip through AsyncLogger...\n";
+    constexpr uint64_t count = 10000;
+    std::stringstream journal(std::ios::in | std::ios::out | std::ios::binary);
+    {
+        AsyncLogger logger(journal, LogOutput::Journal, {}, LogSequence::Off,
+            LogOverflowPolicy{ .mode = LogOverflow::Block, .blockTimeoutUs = 1'000'000 });
+        logger.attachThread();
+        logger.info("Session start %d\n", 1);
+        for (uint64_t i = 0; i < count; ++i) {
+            if (i == count / 2) {
+                logger.journal(JournalGap{ i, i + 9 });
+                logger.journal(JournalRecovery{ i, i + 9, 10 });
+            }
+            logger.journal(JournalItchTrade{ tradeMsg(i) });
+        }
+        logger.log("Session end\n");
+    }
+    const std::string bytes = journal.str();
+    const JournalReader reader(bytes.data(), bytes.size());
+    Collector seen;
+    const uint64_t visited = reader.replay(seen);
+    bool same = seen.trades.size() == count;
+    for (uint64_t i = 0; same && i < count; ++i) {
+        const ITCHTradeMsg sent = tradeMsg(i);
+        same = std::memcmp(&seen.trades[i].msg, &sent, sizeof(sent)) == 0;
+    }
+    std::cout << "\t" << (same ? "🟢" : "🔴") << " " << seen.trades.size() << "/" << count << " ITCH trades back in order, "
+        << double(bytes.size()) / visited << " bytes per record\n";
+    const bool events = seen.gaps.size() == 1 && seen.gaps[0].from == count / 2 && seen.gaps[0].to == count / 2 + 9 &&
+        seen.recoveries.size() == 1 && seen.recoveries[0].recovered == 10;
+    std::cout << "\t" << (events ? "🟢" : "🔴") << " Gap and recovery records\n";
+    const bool notes = seen.notes == std::vector<std::string>{ "INFO | Session start 1\n", "Session end\n" };
+    std::cout << "\t" << (notes ? "🟢" : "🔴") << " Log lines kept as notes\n";
+    const bool indexed = reader.complete() && reader.records() == visited &&
+        reader.index().size() == (visited + Const::journalIndexEvery - 1) / Const::journalIndexEvery &&
+        std::is_sorted(seen.timestamps.begin(), seen.timestamps.end());
+    std::cout << "\t" << (indexed ? "🟢" : "🔴") << " Index footer: " << reader.index().size() << " entries for "
+        << reader.records() << " records, timestamps ascending\n";
+
+    // Starting from an index entry: same records as filtering a full replay
+    const uint64_t fromNs = seen.timestamps[seen.timestamps.size() * 2 / 3];
+    Collector tail;
+    const uint64_t fromVisited = reader.replay(tail, fromNs);
+    const uint64_t expected = std::count_if(seen.timestamps.begin(), seen.timestamps.end(), [&](uint64_t ns) { return ns >= fromNs; });
+    std::cout << "\t" << (fromVisited == expected && tail.timestamps.front() >= fromNs ? "🟢" : "🔴") << " replay from "
+        << fromNs << " ns visits " << fromVisited << "/" << expected << " records\n";
+    Collector head;
+    const uint64_t untilVisited = reader.replay(head, 0, fromNs - 1);
+    std::cout << "\t" << (untilVisited + fromVisited == visited ? "🟢" : "🔴") << " replay until " << fromNs - 1 
+        << " ns visits the other " << untilVisited << "\n";
+
+    // A journal cut short (no footer, no last note, half the last trade) reads up to its last whole record
+    const size_t recordsEnd = bytes.size() - sizeof(Journal::Trailer) - reader.index().size() * sizeof(Journal::IndexEntry);
+    const size_t lastNote = Journal::recordHeaderBytes + sizeof(uint16_t) + std::strlen("Session end\n");
+    const size_t cut = recordsEnd - lastNote - sizeof(JournalItchTrade) / 2;
+    const JournalReader truncated(bytes.data(), cut);
+    Collector partial;
+    truncated.replay(partial);
+    std::cout << "\t" << (!truncated.complete() && partial.trades.size() == count - 1 ? "🟢" : "🔴")
+        << " Journal without footer: " << partial.trades.size() << " whole trades read\n";
+}
+
+/**************************************************************************
+Book changes journaled as they are applied to a live OrderBook replay into a
+fresh one with the same result, every time.
+**************************************************************************/
+std::string snapshot(const OrderBook<false>& book) {
+    std::ostringstream out;
+    book.print(out, "snapshot", 20);
+    out << book.bestBid().first << " " << book.bestBid().second << " " << book.bestAsk().first << " " << book.bestAsk().second;
+    return out.str();
+}
+
+void bookReplayTest() {
+    std::cout << "Testing deterministic OrderBook replay...\n";
+    constexpr int ops = 200'000;
+    const std::string path = "journal_book_test.journal";
+    auto live = std::make_unique<OrderBook<false>>();
+    std::deque<Order> orders;
+    std::vector<Order*> open;
+    {
+        std::ofstream file(path, std::ios::binary);
+        AsyncLogger journal(file, LogOutput::Journal, {}, LogSequence::Off,
+            LogOverflowPolicy{ .mode = LogOverflow::Block, .blockTimeoutUs = 1'000'000 });
+        journal.attachThread();
+        std::mt19937_64 rng(7);
+        std::uniform_real_distribution<double> price(99.5, 100.5);
+        std::uniform_int_distribution<int> qty(1, 100);
+        for (int i = 0; i < ops; ++i) {
+            const uint64_t action = rng() % 10;
+            if (open.empty() || action < 5) {
+                Order& order = orders.emplace_back(Order{ static_cast<uint64_t>(i), price(rng), qty(rng), (rng() & 1) != 0 });
+                live->insert(&order);
+                open.push_back(&order);
+                journal.journal(JournalBookInsert{ order.order_id, order.price, order.quantity, order.is_buy });
+            }
+            else {
+                const size_t pick = rng() % open.size();
+                Order* order = open[pick];
+                if (action < 8) {
+                    const int newQty = qty(rng);
+                    live->update(order->order_id, newQty);
+                    journal.journal(JournalBookUpdate{ order->order_id, newQty });
+                }
+                else {
+                    live->cancel(order->order_id);
+                    open[pick] = open.back();
+                    open.pop_back();
+                    journal.journal(JournalBookCancel{ order->order_id });
+                }
+            }
+        }
+    }
+    const std::string expected = snapshot(*live);
+    const JournalReader reader(path);
+    bool same = true;
+    double ms = 0;
+    for (int run = 0; run < 2; ++run) {
+        auto replayed = std::make_unique<OrderBook<false>>();
+        JournalBookReplay replay(*replayed);
+        const auto start = std::chrono::steady_clock::now();
+        const uint64_t records = reader.replay(replay);
+        ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        same &= records == ops && snapshot(*replayed) == expected;
+    }
+    std::cout << "\t" << (same ? "🟢" : "🔴") << " " << ops << " book changes replayed twice, both books match the live one ("
+        << open.size() << " open orders), " << ms << " ms per replay\n";
+
+    // From the middle of the journal the earlier orders are unknown, their changes are skipped
+    const uint64_t fromNs = reader.index()[reader.index().size() / 2].timestampNs;
+    auto partial = std::make_unique<OrderBook<false>>();
+    JournalBookReplay replayTail(*partial);
+    const uint64_t tailRecords = reader.replay(replayTail, fromNs);
+    std::cout << "\t" << (tailRecords > 0 && tailRecords < ops && replayTail.skipped() > 0 ? "🟢" : "🔴") << " replay from "
+        << fromNs << " ns: " << tailRecords << " records, " << replayTail.skipped() << " changes of earlier orders skipped\n";
+    std::filesystem::remove(path);
+}
+
+/**************************************************************************
+Replay rate of a large journal from a mapped file against a plain memcpy of
+the same bytes (the memory bandwidth it can hope for).
+**************************************************************************/
+void replayBandwidthBenchmark() {
+    constexpr uint64_t count = 5'000'000;
+    std::cout << "Replaying " << count << " ITCH trade records...\n";
+    const std::string path = "journal_bench.journal";
+    {
+        std::ofstream file(path, std::ios::binary);
+        JournalWriter writer(file);
+        for (uint64_t i = 0; i < count; ++i)
+            writer.record(1'700'000'000'000'000'000 + i * 100, JournalItchTrade{ tradeMsg(i) });
+        writer.finish();
+    }
+    const JournalReader reader(path);
+    double volume = 0;
+    uint64_t lastSequence = 0;
+    auto sum = [&](uint64_t, const JournalItchTrade& r) { volume += r.msg.quantity; lastSequence = r.msg.sequence_number; };
+    reader.replay(sum); // page cache warm up
+    volume = 0;
+    const uint64_t t0 = Bench::rdtsc();
+    const uint64_t records = reader.replay(sum);
+    const double replayNs = double(Bench::tscToNs(Bench::rdtsc() - t0));
+
+    std::vector<char> copy(reader.bytes());
+    std::ifstream in(path, std::ios::binary);
+    in.read(copy.data(), copy.size());
+    std::vector<char> target(copy.size());
+    const uint64_t t1 = Bench::rdtsc();
+    std::memcpy(target.data(), copy.data(), copy.size());
+    const double copyNs = double(Bench::tscToNs(Bench::rdtsc() - t1));
+
+    const double gb = reader.bytes() / 1e9;
+    std::cout << "\t" << (records == count && lastSequence == count - 1 ? "🟢" : "🔴") << " replay: " << records << " records, "
+        << gb * 1e9 / records << " bytes each, " << gb / (replayNs / 1e9) << " GB/s, " << records / (replayNs / 1e9) / 1e6
+        << " M records/s (memcpy " << gb / (copyNs / 1e9) << " GB/s), volume " << volume << "\n";
+    std::filesystem::remove(path);
+}
+
+int main() {
+    journalRoundTrip();
+    bookReplayTest();
+    replayBandwidthBenchmark();
+    return 0;
+}
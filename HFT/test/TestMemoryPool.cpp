@@ -1,10 +1,32 @@
 /*
 $ g++ -std=c++20 -O3 -o TestMemoryPool TestMemoryPool.cpp -I../ -DPOOL_MSG_COUNT=100000
-$ numactl --physcpubind=4 ./TestMemoryPool
+$ numactl --physcpubind=4 ./TestMemoryPool --csv pool_bench.csv
+Options:
+    --msgs N            pool capacity and bulk run size
+    --ops N             allocate + free pairs per churn, burst and handoff run
+    --burst N           mean burst size of the burst run
+    --gap-ns N          idle time between bursts
+    --max-threads N     largest thread count of the churn sweep (up to 32)
+    --csv FILE          append one row per run to FILE
+    --stress            only run the stress tests
+
+Allocate/free stress only, also the build to run under ThreadSanitizer:
+$ g++ -std=c++20 -O1 -g -fsanitize=thread -o TestMemoryPool TestMemoryPool.cpp -I../ -latomic
+$ ./TestMemoryPool --stress
+
+Double free, foreign pointer and leak checks need the debug build:
+$ g++ -std=c++20 -O3 -o TestMemoryPool TestMemoryPool.cpp -I../ -DPOOL_DEBUG -DPOOL_MSG_COUNT=100000
 */
 
 #include "MemoryPool.hpp"
+#include "Queue.hpp"
+#include "BenchUtils.hpp"
 #include <thread>
+#include <random>
+#include <unordered_set>
+#include <string_view>
+#include <malloc.h>
+#include "ITCHMessages.hpp"
 
 struct alignas(64) Msg {
     double d[5];
@@ -14,151 +36,853 @@ struct alignas(64) Msg {
 
 /**************************************************************************/
 template <typename Pool>
-void testMemoryPool(const std::string& poolType) {
+void concurrentPoolTest(const std::string& poolType, size_t numThreads, bool verify = false, 
+        size_t rounds = 1, double fill = 1.0) {
+    MemoryPool<Pool> pool;
+    const size_t msgsPerThread = static_cast<size_t>(Const::poolMsgCount * fill) / numThreads;
+    
+    std::cout << "Running concurrent test with " << numThreads << " threads, " << msgsPerThread << 
+            " messages per thread with " << poolType << "using count: " << Const::poolMsgCount << "...\n";
+
+    std::atomic<bool> errorDetected{false};
+
+    std::vector<std::vector<Msg*>> threadAllocations(numThreads);
+
+    auto worker = [&](size_t threadId) {
+        auto& allocated = threadAllocations[threadId];
+        allocated.reserve(msgsPerThread);
+
+        for (size_t round = 0; round < rounds; ++round) {
+            allocated.clear();
+            for (size_t i = 0; i < msgsPerThread; ++i) {
+                Msg* msg = pool.allocate();
+                if (!msg) {
+                    std::cout << "Msg is NULL at index: " << i << " on thread: " << numThreads << "\n";
+                    return;
+                }
+                msg->i = threadId * msgsPerThread + i;  // unique tag
+                allocated.emplace_back(msg);
+            }
+
+            if (verify) {
+                for (size_t i = 0; i < msgsPerThread; ++i) {
+                    if (allocated[i]->i != threadId * msgsPerThread + i) {
+                        std::cout << "Data corruption detected in thread " << threadId 
+                                << " at index " << i << "\n";
+                        errorDetected = true;
+                    }
+                }
+            }
+
+            for (auto* msg : allocated) {
+                pool.deallocate(msg);
+            }
+        }
+    };
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < numThreads; ++t) {
+        threads.emplace_back(worker, t);
+    }
+
+    for (auto& thr : threads) {
+        thr.join();
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    const size_t totalOps = 2 * msgsPerThread * numThreads * rounds; // allocate + deallocate
+
+    std::cout << "\t🟢 Test completed in " << elapsed_ns / 1'000'000 << " ms, " << 
+        ((double)elapsed_ns / totalOps) << " ns/op.\n";
+    if (verify) {
+        if (!errorDetected) {
+            std::cout << "\t🟢 No data corruption detected. Pool is thread-safe under test.\n";
+        } else {
+            std::cout << "\t🔴 Data corruption detected! Pool is NOT thread-safe.\n";
+        }
+    }
+}
+
+/**************************************************************************
+First-touch and TLB cost of the pool backing memory. The storage is faulted in
+either by a separate thread calling prefault() (as the consuming thread would)
+or lazily by the first write pass, then read in random order.
+**************************************************************************/
+void backingTest(const std::string& backingType, const PoolBacking& backing, bool prefaultOnWorker) {
     using namespace std::chrono;
+    constexpr size_t count = 1 << 20; // 64 MB of Msg
+    constexpr size_t randomReads = 1 << 22;
 
-    std::cout << "Testing with " << poolType << "using count: " << Const::poolMsgCount << "...\n";
-    MemoryPool<Pool> pool;
+    std::cout << "Testing backing " << backingType << " with " << count << " msgs...\n";
+    uint64_t faultsBefore = Bench::minorFaults();
+    auto start = steady_clock::now();
+    PoolStorage<Msg> storage(count, backing);
+    auto constructed = steady_clock::now();
+
+    if (prefaultOnWorker) {
+        std::thread([&] { storage.prefault(); }).join();
+    }
+    auto prefaulted = steady_clock::now();
+    auto touchStart = steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        storage[i].i = i;
+    }
+    auto touchEnd = steady_clock::now();
+    uint64_t faults = Bench::minorFaults() - faultsBefore;
+
+    std::vector<uint32_t> order(randomReads);
+    std::mt19937 rng(42);
+    for (auto& index : order) index = rng() % count;
+
+    auto tlbMisses = Bench::PerfCounter::dtlbLoadMisses();
+    size_t checksum = 0;
+    tlbMisses.start();
+    auto readStart = steady_clock::now();
+    for (uint32_t index : order) {
+        checksum += storage[index].i;
+    }
+    auto readEnd = steady_clock::now();
+    uint64_t misses = tlbMisses.stop();
+
+    const double pages = (double)count * sizeof(Msg) / ::sysconf(_SC_PAGESIZE);
+    std::cout << "\t🟢 Construct: " << duration_cast<microseconds>(constructed - start).count() << " us, " <<
+        "worker prefault: " << duration_cast<microseconds>(prefaulted - constructed).count() << " us, " <<
+        "first write pass: " << ((double)duration_cast<nanoseconds>(touchEnd - touchStart).count() / pages) << 
+        " ns/4K page, minor faults: " << faults << "\n";
+    std::cout << "\t🟢 Random read: " << ((double)duration_cast<nanoseconds>(readEnd - readStart).count() / randomReads) <<
+        " ns/op, dTLB misses/op: ";
+    if (tlbMisses.valid()) std::cout << ((double)misses / randomReads); else std::cout << "n/a";
+    std::cout << " (checksum " << checksum % 10 << ")\n";
+}
 
-    std::vector<Msg*> allocatedMsgs(Const::poolMsgCount);
+/**************************************************************************
+Runtime sized pool that starts with capacity msgs and grows by slabs up to
+4 * capacity. Checks that earlier messages never move and that the stats add up.
+**************************************************************************/
+template <typename Pool>
+void growthTest(const std::string& poolType, size_t capacity) {
+    using namespace std::chrono;
+    std::cout << "Testing growth of " << poolType << " from " << capacity << " to " << 4 * capacity << " msgs...\n";
+    Pool pool(capacity, PoolBacking{}, 4 * capacity);
 
-    auto start_allocate = high_resolution_clock::now();
-    for (size_t i = 0; i < Const::poolMsgCount; ++i) {
+    std::vector<Msg*> msgs;
+    auto start = steady_clock::now();
+    for (size_t i = 0; i < 4 * capacity; ++i) {
         Msg* msg = pool.allocate();
+        if (!msg) break;
         msg->i = i;
-        allocatedMsgs[i] = msg;
+        msgs.push_back(msg);
+    }
+    auto end = steady_clock::now();
+    bool stable = msgs.size() == 4 * capacity;
+    for (size_t i = 0; i < msgs.size(); ++i) {
+        stable &= (msgs[i]->i == i);
     }
-    auto end_allocate = high_resolution_clock::now();
+    bool exhausted = false;
+    try {
+        exhausted = (pool.allocate() == nullptr);
+    } catch (const std::exception&) {
+        exhausted = true;
+    }
+    for (Msg* msg : msgs) pool.deallocate(msg);
 
-    for (size_t i = 0; i < Const::poolMsgCount; ++i) {
-        if (allocatedMsgs[i] == nullptr) {
-            std::cout << "Failed to allocate msg at index: " << i << " poolType:" << poolType << std::endl;
-            continue;
+    const PoolStats stats = pool.stats(); // inUse includes msgs parked in this thread's magazine
+    std::cout << "\t" << (stable ? "🟢" : "🔴") << " Allocated " << msgs.size() << " msgs in " << 
+        duration_cast<microseconds>(end - start).count() << " us, no message moved\n";
+    std::cout << "\t" << (exhausted && stats.exhausted == 1 ? "🟢" : "🔴") << " Stops at maxCapacity\n";
+    std::cout << "\t" << (stats.capacity == 4 * capacity && stats.slabs == 4 && 
+        stats.highWatermark == 4 * capacity ? "🟢" : "🔴") << " Stats [capacity: " << stats.capacity << 
+        "] [slabs: " << stats.slabs << "] [inUse: " << stats.inUse << "] [highWatermark: " << 
+        stats.highWatermark << "] [exhausted: " << stats.exhausted << "]\n";
+}
+
+/**************************************************************************
+Non trivial message that counts constructions, destructions run by the typed
+API and can fail to construct.
+**************************************************************************/
+struct Tracked {
+    inline static int live = 0;
+    Tracked() { ++live; }
+    Tracked(int id, std::string name) : id(id), name(std::move(name)) {
+        if (id < 0) throw std::invalid_argument("negative id");
+        ++live;
+    }
+    ~Tracked() { --live; }
+    int id = 0;
+    std::string name;
+};
+
+MemoryPool<CustomLockedPool<Tracked, false>> trackedPool(16);
+
+void typedPoolTest() {
+    std::cout << "Testing create/destroy and PoolPtr on MemoryPool<CustomLockedPool<Tracked, false>>...\n";
+    const int parked = Tracked::live; // free slots hold default constructed msgs
+    {
+        auto msg = trackedPool.make(7, "seven");
+        auto moved = std::move(msg);
+        std::cout << "\t" << (!msg && moved->id == 7 && moved->name == "seven" && 
+            trackedPool.stats().inUse == 1 ? "🟢" : "🔴") << " make() constructs in place, PoolPtr moves\n";
+    }
+    std::cout << "\t" << (trackedPool.stats().inUse == 0 && Tracked::live == parked ? "🟢" : "🔴") << 
+        " PoolPtr returns the msg to the pool at scope exit\n";
+
+    bool thrown = false;
+    try {
+        trackedPool.create(-1, "bad");
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    std::cout << "\t" << (thrown && trackedPool.stats().inUse == 0 && Tracked::live == parked ? "🟢" : "🔴") << 
+        " Throwing constructor returns the slot\n";
+
+    auto pooled = makePooled<trackedPool>(1, "static");
+    Tracked* raw = pooled.release();
+    trackedPool.destroy(raw);
+    std::cout << "\t" << (sizeof(pooled) == sizeof(Tracked*) && trackedPool.stats().inUse == 0 ? "🟢" : "🔴") << 
+        " PoolPtr on a static pool is " << sizeof(pooled) << " bytes, release() + destroy()\n";
+}
+
+// RemoteFreePool reserves MaxOwners heaps but constructs a heap's msgs only when a thread claims it
+void remoteFreeConstructionTest() {
+    std::cout << "Testing lazy heap construction in RemoteFreePool<Tracked, 4>...\n";
+    const int before = Tracked::live;
+    int reserved = 0, claimed = 0;
+    {
+        RemoteFreePool<Tracked, 4> pool(16);
+        reserved = Tracked::live - before;
+        pool.deallocate(pool.allocate());
+        claimed = Tracked::live - before;
+    }
+    std::cout << "\t" << (reserved == 0 && claimed == 16 && Tracked::live == before ? "🟢" : "🔴") << " " << reserved <<
+        " msgs constructed up front, " << claimed << " after one heap is claimed, all destroyed with the pool\n";
+}
+
+/**************************************************************************
+Mixed ITCH 5.0 message sizes (add, delete, execute, cancel, replace, trade, 
+ITCHTradeMsg, gap request) weighted roughly like a busy equity feed.
+**************************************************************************/
+std::vector<uint32_t> itchSizeMix(size_t count) {
+    constexpr std::array<std::pair<uint32_t, uint32_t>, 8> mix{ { 
+        {36, 40}, {19, 25}, {31, 10}, {23, 5}, {35, 10}, {44, 5}, 
+        {ITCHTradeMsgSize, 4}, {ITCHGapRequestMsgSize, 1} } };
+    std::vector<uint32_t> weighted;
+    for (auto [size, weight] : mix) weighted.insert(weighted.end(), weight, size);
+    std::mt19937 rng(7);
+    std::vector<uint32_t> sizes(count);
+    for (auto& size : sizes) size = weighted[rng() % weighted.size()];
+    return sizes;
+}
+
+void sizeClassFragmentation() {
+    constexpr size_t live = 200'000;
+    const auto sizes = itchSizeMix(live);
+    size_t requested = 0, classBytes = 0, mallocBytes = 0, largest = 0;
+    std::vector<void*> blocks;
+    for (uint32_t size : sizes) {
+        requested += size;
+        largest = std::max<size_t>(largest, size);
+        classBytes += DefaultSizeClassPool::classSize(DefaultSizeClassPool::classOf(size));
+        void* block = std::malloc(size);
+        mallocBytes += ::malloc_usable_size(block) + sizeof(size_t); // plus the chunk header
+        blocks.push_back(block);
+    }
+    for (void* block : blocks) std::free(block);
+    const size_t paddedBytes = live * DefaultSizeClassPool::classSize(DefaultSizeClassPool::classOf(largest));
+
+    std::cout << "Fragmentation for " << live << " live ITCH msgs, " << requested << " bytes requested...\n";
+    auto report = [&](const char* name, size_t bytes) {
+        std::cout << "\t🟢 " << name << ": " << bytes << " bytes, " << 
+            (100.0 * (bytes - requested) / bytes) << "% internal fragmentation\n";
+    };
+    report("DefaultSizeClassPool", classBytes);
+    report("Single pool padded to the largest msg", paddedBytes);
+    report("malloc", mallocBytes);
+}
+
+/**************************************************************************
+Steady state churn over a window of live msgs: every op frees the oldest msg
+and allocates one of the next size in the mix. numThreads threads share the
+allocator, ns/op is per allocate + free pair.
+**************************************************************************/
+template <typename Alloc, typename Free>
+void churnRun(const std::string& name, size_t numThreads, Alloc&& alloc, Free&& dealloc) {
+    constexpr size_t window = 1024;
+    constexpr size_t ops = 2'000'000;
+    const auto sizes = itchSizeMix(ops + window);
+    std::atomic<bool> failed{false};
+    auto worker = [&](size_t threadId) {
+        std::vector<std::pair<void*, uint32_t>> ring(window);
+        const size_t offset = threadId * 7919;
+        for (size_t i = 0; i < window; ++i) {
+            const uint32_t size = sizes[(offset + i) % sizes.size()];
+            ring[i] = { alloc(size), size };
         }
-        else if (allocatedMsgs[i]->i != i) {
-            std::cout << "Mismatch at index: " << i << ", expected: " << i 
-                      << ", got: " << allocatedMsgs[i]->i << " poolType:" << poolType << std::endl;
+        for (size_t i = 0; i < ops / numThreads; ++i) {
+            auto& slot = ring[i % window];
+            dealloc(slot.first, slot.second);
+            const uint32_t size = sizes[(offset + window + i) % sizes.size()];
+            slot = { alloc(size), size };
+            if (!slot.first) [[unlikely]] {
+                failed = true;
+                return;
+            }
         }
-    }
+        for (auto& [block, size] : ring) if (block) dealloc(block, size);
+    };
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < numThreads; ++t) threads.emplace_back(worker, t);
+    for (auto& thr : threads) thr.join();
+    auto end = std::chrono::steady_clock::now();
+    const double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    std::cout << "\t" << (failed ? "🔴" : "🟢") << " " << name << " " << numThreads << " threads: " << 
+        (ns / ops) << " ns/op\n";
+}
 
-    auto start_deallocate = high_resolution_clock::now();
-    for (auto& msg : allocatedMsgs) {
-        pool.deallocate(msg);
+void sizeClassThroughput() {
+    std::cout << "Throughput of mixed size allocate/free...\n";
+    using Padded = LockFreeThreadSafePool<std::array<std::byte, 48>, true>;
+    for (size_t threads : {1, 4}) {
+        DefaultSizeClassPool pool(1 << 14);
+        churnRun("SizeClassPool allocate(bytes)", threads, 
+            [&](size_t bytes) { return pool.allocate(bytes); }, 
+            [&](void* ptr, size_t bytes) { pool.deallocate(ptr, bytes); });
+        churnRun("SizeClassPool deallocate(ptr) by address", threads, 
+            [&](size_t bytes) { return pool.allocate(bytes); }, 
+            [&](void* ptr, size_t) { pool.deallocate(ptr); });
+        MemoryPool<DefaultSizeClassPool::Typed<ITCHTradeMsg>> trades(pool);
+        churnRun("SizeClassPool::Typed<ITCHTradeMsg>", threads, 
+            [&](size_t) { return static_cast<void*>(trades.allocate()); }, 
+            [&](void* ptr, size_t) { trades.deallocate(static_cast<ITCHTradeMsg*>(ptr)); });
+        Padded padded(1 << 14);
+        churnRun("Single pool padded to 48 bytes", threads, 
+            [&](size_t) { return static_cast<void*>(padded.allocate()); }, 
+            [&](void* ptr, size_t) { padded.deallocate(static_cast<Padded::MsgPtr>(ptr)); });
+        churnRun("malloc/free", threads, 
+            [](size_t bytes) { return std::malloc(bytes); }, 
+            [](void* ptr, size_t) { std::free(ptr); });
     }
-    auto end_deallocate = high_resolution_clock::now();
+}
 
+/**************************************************************************
+Pool benchmark harness. Every run prints one line and appends one CSV row
+(--csv), timings are TSC based with ns resolution, latency percentiles are per
+operation (or per burst, see burstRun). rss_kb and minor_faults are the process
+deltas over the run, the cold bulk run shows what the pool costs to fault in.
+**************************************************************************/
+struct BenchConfig {
+    size_t msgs = Const::poolMsgCount;  // pool capacity and bulk run size
+    size_t ops = 1 << 21;               // allocate + free pairs per churn / burst run
+    size_t burst = 64;                  // mean burst size, bursts vary from 1 to 2 * burst
+    uint64_t gapNs = 2'000;             // idle time between bursts
+    size_t maxThreads = 8;
+    std::string csvPath;
+    bool stressOnly = false;
+};
 
-    auto duration_allocate = duration_cast<milliseconds>(end_allocate - start_allocate).count();
-    auto duration_deallocate = duration_cast<milliseconds>(end_deallocate - start_deallocate).count();
-    
-    std::cout << "\t🟢 Allocate Time: " << duration_allocate << " ms " << 
-        (((double)duration_allocate / Const::poolMsgCount) * 1'000'000) << " ns/op\n";
-    std::cout << "\t🔴 Deallocate Time: " << duration_deallocate << "ms " << 
-        (((double)duration_deallocate / Const::poolMsgCount) * 1'000'000)<< " ns/op\n";
+const std::string csvHeader = "bench,pool,msg_bytes,threads,ops,elapsed_ns,ns_per_op,"
+    "p50_ns,p99_ns,p999_ns,max_ns,rss_kb,minor_faults,errors";
+
+// Process RSS and minor faults at construction, deltas on read
+struct MemoryDelta {
+    uint64_t rssKb = Bench::residentKb();
+    uint64_t faults = Bench::minorFaults();
+    int64_t rssDelta() const { return (int64_t)Bench::residentKb() - (int64_t)rssKb; }
+    uint64_t faultsDelta() const { return Bench::minorFaults() - faults; }
+};
+
+// hist holds TSC ticks, converted to ns here
+void report(Bench::CsvWriter& csv, const std::string& bench, const std::string& poolType, size_t threads,
+        size_t ops, uint64_t elapsedNs, const Bench::LatencyHistogram& hist, const MemoryDelta& memory,
+        size_t errors) {
+    const double nsPerOp = ops ? (double)elapsedNs / ops : 0.0;
+    const int64_t rssKb = memory.rssDelta();
+    const uint64_t faults = memory.faultsDelta();
+    const auto ns = [&](double p) { return Bench::tscToNs(hist.percentile(p)); };
+    std::cout << "\t" << (errors == 0 ? "🟢 " : "🔴 ") << bench << " t:" << threads << " " << nsPerOp << 
+        " ns/op p50:" << ns(50) << "ns p99:" << ns(99) << "ns p99.9:" << ns(99.9) << "ns max:" << 
+        Bench::tscToNs(hist.max()) << "ns rss:" << rssKb << "KB faults:" << faults << 
+        (errors ? " errors:" + std::to_string(errors) : "") << "\n";
+    csv.row(bench, poolType, sizeof(Msg), threads, ops, elapsedNs, nsPerOp, ns(50), ns(99), ns(99.9),
+        Bench::tscToNs(hist.max()), rssKb, faults, errors);
 }
 
-/**************************************************************************/
 template <typename Pool>
-void concurrentPoolTest(const std::string& poolType, size_t numThreads, bool verify = false) {
-    MemoryPool<Pool> pool;
-    const size_t msgsPerThread = Const::poolMsgCount / numThreads;
-    
-    std::cout << "Running concurrent test with " << numThreads << " threads, " << msgsPerThread << 
-            " messages per thread with " << poolType << "using count: " << Const::poolMsgCount << "...\n";
+std::unique_ptr<Pool> makePool(size_t capacity) {
+    if constexpr (std::is_constructible_v<Pool, size_t>) 
+        return std::make_unique<Pool>(capacity);
+    else 
+        return std::make_unique<Pool>(); // BoostPool is unbounded
+}
 
-    std::atomic<bool> errorDetected{false};
+/**************************************************************************
+Allocate the whole pool then free it all, allocate and free timed separately.
+The first pass on a fresh pool pays the page faults, the second is warm.
+**************************************************************************/
+template <typename Pool>
+void bulkRun(const std::string& poolType, const BenchConfig& cfg, Bench::CsvWriter& csv) {
+    MemoryDelta constructed; // the cold pass includes faulting in the pool storage
+    auto pool = makePool<Pool>(cfg.msgs);
+    std::vector<Msg*> msgs(cfg.msgs);
+    for (bool cold : { true, false }) {
+        MemoryDelta allocMemory = cold ? constructed : MemoryDelta{};
+        Bench::LatencyHistogram allocHist, freeHist;
+        size_t errors = 0;
+        const uint64_t allocStart = Bench::rdtsc();
+        for (size_t i = 0; i < cfg.msgs; ++i) {
+            const uint64_t t0 = Bench::rdtsc();
+            Msg* msg = pool->allocate();
+            allocHist.record(Bench::rdtsc() - t0);
+            if (!msg) [[unlikely]] {
+                ++errors;
+                break;
+            }
+            msg->i = i;
+            msgs[i] = msg;
+        }
+        const uint64_t allocEnd = Bench::rdtsc();
+        report(csv, cold ? "bulk_alloc_cold" : "bulk_alloc", poolType, 1, cfg.msgs, 
+            Bench::tscToNs(allocEnd - allocStart), allocHist, allocMemory, errors);
+        if (errors) 
+            return;
 
-    std::vector<std::vector<Msg*>> threadAllocations(numThreads);
+        MemoryDelta freeMemory;
+        for (size_t i = 0; i < cfg.msgs; ++i) {
+            errors += (msgs[i]->i != i);
+            const uint64_t t0 = Bench::rdtsc();
+            pool->deallocate(msgs[i]);
+            freeHist.record(Bench::rdtsc() - t0);
+        }
+        report(csv, cold ? "bulk_free_cold" : "bulk_free", poolType, 1, cfg.msgs, 
+            Bench::tscToNs(Bench::rdtsc() - allocEnd), freeHist, freeMemory, errors);
+    }
+}
+
+/**************************************************************************
+Steady state churn: every thread holds a window of live msgs and frees a 
+random one before allocating its replacement, so the free list order gets
+shuffled the way a long running process shuffles it. Windows add up to half
+the pool, the rest is headroom for per-thread caches. One op is one free +
+allocate pair.
+**************************************************************************/
+template <typename Pool>
+void steadyChurnRun(const std::string& poolType, const BenchConfig& cfg, Bench::CsvWriter& csv, size_t numThreads) {
+    auto pool = makePool<Pool>(cfg.msgs);
+    const size_t window = std::max<size_t>(cfg.msgs / (2 * numThreads), 1);
+    const size_t opsPerThread = cfg.ops / numThreads;
+    std::vector<Bench::LatencyHistogram> hists(numThreads);
+    std::atomic<size_t> errors{0};
+    std::atomic<size_t> ready{0};
+    std::atomic<bool> go{false};
 
     auto worker = [&](size_t threadId) {
-        auto& allocated = threadAllocations[threadId];
-        allocated.reserve(msgsPerThread);
+        std::vector<Msg*> live(window);
+        for (size_t i = 0; i < window; ++i) {
+            live[i] = pool->allocate();
+            if (!live[i]) { errors.fetch_add(1); break; }
+            live[i]->i = i;
+        }
+        ready.fetch_add(1);
+        while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
 
-        for (size_t i = 0; i < msgsPerThread; ++i) {
-            Msg* msg = pool.allocate();
-            if (!msg) {
-                std::cout << "Msg is NULL at index: " << i << " on thread: " << numThreads << "\n";
-                return;
+        uint64_t state = 0x9E3779B97F4A7C15ull * (threadId + 1);
+        for (size_t op = 0; op < opsPerThread && !errors.load(std::memory_order_relaxed); ++op) {
+            state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+            const size_t slot = state % window;
+            if (live[slot]->i != slot) [[unlikely]] errors.fetch_add(1);
+            const uint64_t t0 = Bench::rdtsc();
+            pool->deallocate(live[slot]);
+            Msg* msg = pool->allocate();
+            hists[threadId].record(Bench::rdtsc() - t0);
+            if (!msg) [[unlikely]] {
+                errors.fetch_add(1);
+                live[slot] = nullptr;
+                break;
             }
-            msg->i = threadId * msgsPerThread + i;  // unique tag
-            allocated.emplace_back(msg);
+            msg->i = slot;
+            live[slot] = msg;
         }
+        for (Msg* msg : live) if (msg) pool->deallocate(msg);
+    };
 
-        if (verify) {
-            for (size_t i = 0; i < msgsPerThread; ++i) {
-                if (allocated[i]->i != threadId * msgsPerThread + i) {
-                    std::cout << "Data corruption detected in thread " << threadId 
-                            << " at index " << i << "\n";
-                    errorDetected = true;
-                }
-            }
+    MemoryDelta memory;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < numThreads; ++t) threads.emplace_back(worker, t);
+    while (ready.load() < numThreads) std::this_thread::yield();
+    const uint64_t start = Bench::rdtsc();
+    go.store(true, std::memory_order_release);
+    for (auto& thr : threads) thr.join();
+    const uint64_t end = Bench::rdtsc();
+
+    Bench::LatencyHistogram hist;
+    for (auto& h : hists) hist.merge(h);
+    report(csv, "churn", poolType, numThreads, opsPerThread * numThreads, Bench::tscToNs(end - start), hist, 
+        memory, errors);
+}
+
+/**************************************************************************
+Receiver style bursts on one thread: allocate a burst (1 to 2 * burst msgs),
+write them, free them, then sit idle for gapNs so the pool state cools down
+between bursts. Percentiles are per msg of each burst (burst time / size).
+**************************************************************************/
+template <typename Pool>
+void burstRun(const std::string& poolType, const BenchConfig& cfg, Bench::CsvWriter& csv) {
+    auto pool = makePool<Pool>(cfg.msgs);
+    const uint64_t gapTicks = static_cast<uint64_t>(cfg.gapNs * Bench::tscPerNs());
+    std::vector<Msg*> burst(2 * cfg.burst);
+    std::mt19937 rng(3);
+    Bench::LatencyHistogram hist;
+    size_t errors = 0, ops = 0;
+    uint64_t busyTicks = 0;
+
+    MemoryDelta memory;
+    while (ops < cfg.ops && errors == 0) {
+        const size_t size = 1 + rng() % (2 * cfg.burst);
+        const uint64_t t0 = Bench::rdtsc();
+        size_t allocated = 0;
+        for (; allocated < size; ++allocated) {
+            Msg* msg = pool->allocate();
+            if (!msg) [[unlikely]] break;
+            msg->i = allocated;
+            burst[allocated] = msg;
         }
+        for (size_t i = 0; i < allocated; ++i) pool->deallocate(burst[i]);
+        errors += size - allocated;
+        const uint64_t t1 = Bench::rdtsc();
+        busyTicks += t1 - t0;
+        hist.record((t1 - t0) / size);
+        ops += size;
+        while (Bench::rdtsc() - t1 < gapTicks) Bench::cpuRelax();
+    }
+    report(csv, "burst", poolType, 1, ops, Bench::tscToNs(busyTicks), hist, memory, errors);
+}
+
+/**************************************************************************
+Producer/consumer handoff as in the receiver and the logger: producers
+allocate and enqueue, one consumer dequeues, checks per producer order and
+frees. Percentiles are the consumer side deallocate cost, ns/op is wall time
+per msg.
+**************************************************************************/
+template <typename Pool>
+void handoffRun(const std::string& poolType, const BenchConfig& cfg, Bench::CsvWriter& csv, size_t producers) {
+    auto pool = makePool<Pool>(cfg.msgs);
+    CustomMPSCLockFreeQueue<Msg*> queue(1024);
+    const size_t perProducer = cfg.ops / producers;
+    std::atomic<size_t> errors{0};
 
-        for (auto* msg : allocated) {
-            pool.deallocate(msg);
+    auto producer = [&](size_t threadId) {
+        for (size_t i = 0; i < perProducer; ++i) {
+            Msg* msg;
+            while (!(msg = pool->allocate())) std::this_thread::yield(); // consumer still has them
+            msg->i = i;
+            msg->c = static_cast<char>(threadId);
+            while (!queue.enqueue(msg)) std::this_thread::yield();
         }
     };
+    MemoryDelta memory;
+    Bench::LatencyHistogram hist;
+    const uint64_t start = Bench::rdtsc();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < producers; ++t) threads.emplace_back(producer, t);
+    std::vector<size_t> next(producers, 0);
+    for (size_t received = 0; received < perProducer * producers; ) {
+        Msg* msg = queue.dequeue();
+        if (!msg) {
+            std::this_thread::yield();
+            continue;
+        }
+        size_t& expected = next[static_cast<size_t>(msg->c)];
+        if (msg->i != expected++) errors.fetch_add(1);
+        const uint64_t t0 = Bench::rdtsc();
+        pool->deallocate(msg);
+        hist.record(Bench::rdtsc() - t0);
+        ++received;
+    }
+    for (auto& thr : threads) thr.join();
+    report(csv, "handoff", poolType, producers + 1, perProducer * producers, 
+        Bench::tscToNs(Bench::rdtsc() - start), hist, memory, errors);
+}
 
-    auto start = std::chrono::high_resolution_clock::now();
+// Thread-unsafe pools only get the single threaded patterns
+template <typename Pool>
+void poolSuite(const std::string& poolType, const BenchConfig& cfg, Bench::CsvWriter& csv, bool threadSafe) {
+    std::cout << "Benchmarking " << poolType << " with " << cfg.msgs << " msgs of " << sizeof(Msg) << " bytes...\n";
+    bulkRun<Pool>(poolType, cfg, csv);
+    steadyChurnRun<Pool>(poolType, cfg, csv, 1);
+    burstRun<Pool>(poolType, cfg, csv);
+    if (!threadSafe) 
+        return;
+    for (size_t threads = 2; threads <= cfg.maxThreads; threads *= 2) {
+        steadyChurnRun<Pool>(poolType, cfg, csv, threads);
+    }
+    for (size_t producers : {1, 2}) {
+        handoffRun<Pool>(poolType, cfg, csv, producers);
+    }
+}
+
+/**************************************************************************
+ABA stress: a pool of only 4 msgs per thread keeps the free stack head hot and
+regularly empty while threads pop and push random sized batches. A msg handed
+to two threads at once shows up as a changed stamp (and as a data race under
+TSAN), a lost or duplicated free list entry as a wrong count at the end.
+**************************************************************************/
+template <typename Pool>
+void stressTest(const std::string& poolType, size_t numThreads, size_t iterations, size_t maxCapacity = 0) {
+    using namespace std::chrono;
+    const size_t capacity = 4 * numThreads;
+    std::cout << "Stress testing " << poolType << " with " << numThreads << " threads, " << capacity << 
+        " msgs" << (maxCapacity ? " growing to " + std::to_string(maxCapacity) : std::string{}) << "...\n";
+    std::unique_ptr<Pool> owned;
+    if constexpr (std::is_constructible_v<Pool, size_t, PoolBacking, size_t>)
+        owned = std::make_unique<Pool>(capacity, PoolBacking{}, maxCapacity);
+    else 
+        owned = std::make_unique<Pool>(capacity); // fixed capacity pools
+    Pool& pool = *owned;
+
+    std::atomic<bool> corrupted{false};
+    std::atomic<uint64_t> empty{0};
+    auto worker = [&](size_t threadId) {
+        std::mt19937 rng(static_cast<uint32_t>(threadId));
+        std::vector<Msg*> held;
+        for (size_t iter = 0; iter < iterations; ++iter) {
+            const size_t batch = 1 + rng() % 8;
+            for (size_t i = 0; i < batch; ++i) {
+                Msg* msg = pool.allocate();
+                if (!msg) {
+                    empty.fetch_add(1, std::memory_order_relaxed);
+                    break;
+                }
+                msg->i = (threadId << 32) | iter;
+                msg->c = static_cast<char>(i);
+                held.push_back(msg);
+            }
+            for (size_t i = 0; i < held.size(); ++i) {
+                if (held[i]->i != ((threadId << 32) | iter) || held[i]->c != static_cast<char>(i))
+                    corrupted = true;
+                pool.deallocate(held[i]);
+            }
+            held.clear();
+        }
+    };
 
+    auto start = steady_clock::now();
     std::vector<std::thread> threads;
     for (size_t t = 0; t < numThreads; ++t) {
         threads.emplace_back(worker, t);
     }
-
     for (auto& thr : threads) {
         thr.join();
     }
+    auto end = steady_clock::now();
 
-    auto end = std::chrono::high_resolution_clock::now();
-    auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    // every msg must come back exactly once
+    std::unordered_set<Msg*> unique;
+    while (Msg* msg = pool.allocate()) {
+        unique.insert(msg);
+    }
+    const size_t expected = pool.stats().capacity;
+    std::cout << "\t" << (!corrupted ? "🟢" : "🔴") << " " << numThreads * iterations << " iterations in " << 
+        duration_cast<milliseconds>(end - start).count() << " ms, pool empty " << empty << " times\n";
+    std::cout << "\t" << (unique.size() == expected ? "🟢" : "🔴") << " Recovered " << unique.size() << 
+        " distinct msgs of " << expected << "\n";
+    for (Msg* msg : unique) {
+        pool.deallocate(msg);
+    }
+}
 
-    std::cout << "\t🟢 Test completed in " << elapsed_ms << " ms.\n";
-    if (verify) {
-        if (!errorDetected) {
-            std::cout << "\t🟢 No data corruption detected. Pool is thread-safe under test.\n";
-        } else {
-            std::cout << "\t🔴 Data corruption detected! Pool is NOT thread-safe.\n";
+/**************************************************************************
+Magazine teardown race: threads holding magazines exit while the pool is being
+destroyed. Each exiting thread either flushes into the live pool or sees it
+detached, never pushChain()s into freed slabs (run under ASAN/TSAN to see it).
+**************************************************************************/
+void magazineTeardownTest(size_t numThreads, size_t rounds) {
+    using Pool = LockFreeThreadSafePool<Msg, true, 4>;
+    std::cout << "Destroying magazine pools under " << numThreads << " exiting threads, " << rounds << " rounds...\n";
+    for (size_t round = 0; round < rounds; ++round) {
+        auto pool = std::make_unique<Pool>(16 * numThreads);
+        std::atomic<size_t> ready{ 0 };
+        std::atomic<bool> exit{ false };
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < numThreads; ++t) {
+            threads.emplace_back([&] {
+                Msg* msgs[6];
+                for (Msg*& msg : msgs) msg = pool->allocate();
+                for (Msg* msg : msgs) if (msg) pool->deallocate(msg); // leaves msgs in the magazine
+                ready.fetch_add(1);
+                while (!exit.load()) std::this_thread::yield();
+            }); // thread exit flushes the magazine
         }
+        while (ready.load() < numThreads) std::this_thread::yield();
+        exit = true;
+        pool.reset(); // races with the flushes
+        for (auto& thr : threads) thr.join();
     }
+    std::cout << "\t🟢 " << rounds << " pools destroyed under exiting threads\n";
 }
 
-int main() {
-    
-    testMemoryPool<BoostPool<Msg, false>>("BoostPool<Msg, false>");
-    testMemoryPool<CustomLockedPool<Msg, false>>("CustomLockedPool<Msg, false>");
-    testMemoryPool<CustomLockFreePool<Msg, false>>("CustomLockFreePool<Msg, false>");
+void stressTests() {
+    magazineTeardownTest(8, 200);
+    for (size_t threads : {2, 8, 32}) {
+        stressTest<CustomLockFreePool<Msg, true>>("CustomLockFreePool<Msg, true>", threads, 50'000);
+        stressTest<LockFreeThreadSafePool<Msg, true>>("LockFreeThreadSafePool<Msg, true>", threads, 50'000);
+        stressTest<LockFreeThreadSafePool<Msg, true, 0, true>>(
+            "LockFreeThreadSafePool<Msg, true, 0, true>", threads, 50'000);
+        stressTest<LockFreeThreadSafePool<Msg, true, 4>>("LockFreeThreadSafePool<Msg, true, 4>", threads, 50'000);
+        stressTest<LockFreeThreadSafePool<Msg, true>>(
+            "LockFreeThreadSafePool<Msg, true>", threads, 50'000, 64 * threads);
+    }
+}
+
+/**************************************************************************
+Misuse the pool on purpose, each misuse must throw before it reaches the free
+list. The msg left allocated at the end shows up in the leak report on stderr.
+**************************************************************************/
+template <typename Pool>
+void debugTest(const std::string& poolType) {
+    std::cout << "Debug checks on " << poolType << "...\n";
+    Pool pool(8);
+    auto expectThrow = [&](const char* what, auto&& misuse) {
+        try {
+            misuse();
+            std::cout << "\t🔴 " << what << " not detected\n";
+        } catch (const std::exception& e) {
+            std::cout << "\t🟢 " << what << ": " << e.what() << "\n";
+        }
+    };
+    Msg* msg = pool.allocate();
+    pool.deallocate(msg);
+    expectThrow("Double free", [&] { pool.deallocate(msg); });
+    Msg foreign{};
+    expectThrow("Foreign pointer", [&] { pool.deallocate(&foreign); });
+    Msg* leaked = pool.allocate();
+    expectThrow("Interior pointer", [&] { pool.deallocate(reinterpret_cast<Msg*>(reinterpret_cast<char*>(leaked) + 8)); });
+    Msg* other = pool.allocate();
+    pool.deallocate(other);
+    std::cout << "\t🟢 Destroying with one msg still allocated, expect a leak report\n";
+}
+
+void debugTests() {
+    if constexpr (!Const::poolDebug) {
+        std::cout << "Pool debug checks compiled out (build with -DPOOL_DEBUG), tracker is " << 
+            (std::is_empty_v<PoolSlotTracker<>> ? "🟢 empty\n" : "🔴 not empty\n");
+        return;
+    }
+    debugTest<CustomLockedPool<Msg, true>>("CustomLockedPool<Msg, true>");
+    debugTest<CustomLockFreePool<Msg, true>>("CustomLockFreePool<Msg, true>");
+    debugTest<LockFreeThreadSafePool<Msg, true>>("LockFreeThreadSafePool<Msg, true>");
+    debugTest<LockFreeThreadSafePool<Msg, true, 4>>("LockFreeThreadSafePool<Msg, true, 4>");
+    debugTest<RemoteFreePool<Msg>>("RemoteFreePool<Msg>");
+}
+
+/**************************************************************************/
+BenchConfig parseArgs(int argc, char** argv) {
+    BenchConfig cfg;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view key = argv[i];
+        if (key == "--stress") {
+            cfg.stressOnly = true;
+            continue;
+        }
+        if (i + 1 >= argc) throw std::invalid_argument("Missing value for " + std::string(key));
+        const std::string value = argv[++i];
+        if (key == "--msgs") cfg.msgs = std::stoul(value);
+        else if (key == "--ops") cfg.ops = std::stoul(value);
+        else if (key == "--burst") cfg.burst = std::stoul(value);
+        else if (key == "--gap-ns") cfg.gapNs = std::stoul(value);
+        else if (key == "--max-threads") cfg.maxThreads = std::min<size_t>(std::stoul(value), 32);
+        else if (key == "--csv") cfg.csvPath = value;
+        else throw std::invalid_argument("Unknown option " + std::string(key));
+    }
+    return cfg;
+}
+
+int main(int argc, char** argv) {
+    const BenchConfig cfg = parseArgs(argc, argv);
+    if (cfg.stressOnly) {
+        stressTests();
+        return 0;
+    }
 
     concurrentPoolTest<BoostPool<Msg, true>>("BoostPool<Msg, true>", 10, true);
+    concurrentPoolTest<CustomLockFreePool<Msg, true>>("CustomLockFreePool<Msg, true>", 10, true);
     concurrentPoolTest<LockFreeThreadSafePool<Msg, true>>("LockFreeThreadSafePool<Msg, true>", 10, true);
+
+    // Scaling with and without per-thread magazines, half the pool in flight leaves
+    // headroom for messages parked in other threads' magazines
+    for (size_t threads = 1; threads <= 32; threads *= 2) {
+        concurrentPoolTest<LockFreeThreadSafePool<Msg, true>>(
+            "LockFreeThreadSafePool<Msg, true>", threads, true, 10, 0.5);
+        concurrentPoolTest<LockFreeThreadSafePool<Msg, true, 64>>(
+            "LockFreeThreadSafePool<Msg, true, 64>", threads, true, 10, 0.5);
+    }
     
+    typedPoolTest();
+    remoteFreeConstructionTest();
+    debugTests();
+
+    Bench::CsvWriter csv(cfg.csvPath, csvHeader);
+    // object_pool::destroy keeps the free list ordered, O(free msgs) per free, so boost
+    // gets a smaller pool and fewer ops (msgs and ops are in every CSV row)
+    BenchConfig boostCfg = cfg;
+    boostCfg.msgs = std::min<size_t>(cfg.msgs, 10'000);
+    boostCfg.ops = cfg.ops / 16;
+    poolSuite<BoostPool<Msg, false>>("BoostPool<Msg, false>", boostCfg, csv, false);
+    poolSuite<BoostPool<Msg, true>>("BoostPool<Msg, true>", boostCfg, csv, true);
+    poolSuite<CustomLockedPool<Msg, false>>("CustomLockedPool<Msg, false>", cfg, csv, false);
+    poolSuite<CustomLockedPool<Msg, true>>("CustomLockedPool<Msg, true>", cfg, csv, true);
+    poolSuite<CustomLockFreePool<Msg, true>>("CustomLockFreePool<Msg, true>", cfg, csv, true);
+    poolSuite<LockFreeThreadSafePool<Msg, true>>("LockFreeThreadSafePool<Msg, true>", cfg, csv, true);
+    poolSuite<LockFreeThreadSafePool<Msg, true, 0, true>>("LockFreeThreadSafePool<Msg, true, 0, true>", cfg, csv, true);
+    poolSuite<LockFreeThreadSafePool<Msg, true, 64>>("LockFreeThreadSafePool<Msg, true, 64>", cfg, csv, true);
+    poolSuite<RemoteFreePool<Msg, 32>>("RemoteFreePool<Msg, 32>", cfg, csv, true);
+
+    sizeClassFragmentation();
+    sizeClassThroughput();
+
+    growthTest<CustomLockedPool<Msg, true>>("CustomLockedPool<Msg, true>", 1000);
+    growthTest<LockFreeThreadSafePool<Msg, true>>("LockFreeThreadSafePool<Msg, true>", 1000);
+    growthTest<LockFreeThreadSafePool<Msg, true, 64>>("LockFreeThreadSafePool<Msg, true, 64>", 1000);
+
+    stressTests();
+
+    backingTest("Normal", {}, false);
+    backingTest("Normal + prefault on worker", {}, true);
+    backingTest("TransparentHuge", {PoolBacking::Pages::TransparentHuge}, false);
+    backingTest("HugeTLB", {PoolBacking::Pages::HugeTLB}, false);
+    backingTest("HugeTLB + NUMA node 0 + prefault", {PoolBacking::Pages::HugeTLB, 0, true}, false);
+
     // concurrentPoolTest<CustomLockedPool<Msg, false>>("CustomLockedPool<Msg, true>", 10, true);
-    // concurrentPoolTest<CustomLockFreePool<Msg, true>>("CustomLockFreePool<Msg, true>", 10, true);
     // concurrentPoolTest<FollyIndexedMemPool<Msg, true>>("FollyIndexedMemPool<Msg, true>", 10, true);
 
     return 0;
 }
 
 /*
-Testing with BoostPool<Msg, false>using count: 100000...
-BoostPool initialized for type: 3Msg
-	🟢 Allocate Time: 4 ms 40 ns/op
-	🔴 Deallocate Time: 7738ms 77380 ns/op
-Testing with CustomLockedPool<Msg, false>using count: 100000...
-CustomLockedPool initialized for type: 3Msg
-	🟢 Allocate Time: 0 ms 0 ns/op
-	🔴 Deallocate Time: 0ms 0 ns/op
-Testing with CustomLockFreePool<Msg, false>using count: 100000...
-CustomLockFreePool initialized for type: 3Msg
-Warning: CustomLockFreePool is thread-safe always
-	🟢 Allocate Time: 1 ms 10 ns/op
-	🔴 Deallocate Time: 1ms 10 ns/op
-BoostPool initialized for type: 3Msg
-
-Running concurrent test with 10 threads, 10000 messages per thread with BoostPool<Msg, true>using count: 100000...
-	🟢 Test completed in 15357 ms.
+Sample output (1 CPU box, default BenchConfig, abridged)
+
+Running concurrent test with 10 threads, 26214 messages per thread with CustomLockFreePool<Msg, true>using count: 262144...
+	🟢 Test completed in 15 ms, 29.6001 ns/op.
 	🟢 No data corruption detected. Pool is thread-safe under test.
-Running concurrent test with 10 threads, 10000 messages per thread with LockFreeThreadSafePool<Msg, true>using count: 100000...
-	🟢 Test completed in 32 ms.
+Running concurrent test with 32 threads, 4096 messages per thread with LockFreeThreadSafePool<Msg, true, 64>using count: 262144...
+	🟢 Test completed in 49 ms, 19.0707 ns/op.
 	🟢 No data corruption detected. Pool is thread-safe under test.
-*/
\ No newline at end of file
+Benchmarking CustomLockFreePool<Msg, true> with 262144 msgs of 64 bytes...
+	🟢 bulk_alloc_cold t:1 112.789 ns/op p50:49ns p99:99ns p99.9:383ns max:75317ns rss:18492KB faults:4623
+	🟢 bulk_alloc t:1 78.26 ns/op p50:46ns p99:327ns p99.9:543ns max:36864ns rss:0KB faults:0
+	🟢 churn t:1 411.867 ns/op p50:375ns p99:767ns p99.9:1343ns max:393001ns rss:8600KB faults:2150
+	🟢 burst t:1 41.4021 ns/op p50:41ns p99:83ns p99.9:151ns max:6716ns rss:8KB faults:2
+	🟢 churn t:8 259.87 ns/op p50:207ns p99:703ns p99.9:1151ns max:32017459ns rss:8192KB faults:2056
+	🟢 handoff t:2 100.784 ns/op p50:48ns p99:55ns p99.9:60ns max:3642865ns rss:68KB faults:17
+Benchmarking RemoteFreePool<Msg, 32> with 262144 msgs of 64 bytes...
+	🟢 churn t:8 279.701 ns/op p50:171ns p99:623ns p99.9:991ns max:87121885ns rss:15852KB faults:3971
+	🟢 handoff t:2 114.213 ns/op p50:59ns p99:67ns p99.9:239ns max:421892ns rss:16384KB faults:4096
+Fragmentation for 200000 live ITCH msgs, 6199162 bytes requested...
+	🟢 DefaultSizeClassPool: 8287760 bytes, 25.201% internal fragmentation
+	🟢 malloc: 8898480 bytes, 30.3346% internal fragmentation
+Stress testing CustomLockFreePool<Msg, true> with 2 threads, 8 msgs...
+	🟢 100000 iterations in 14 ms, pool empty 32075 times
+	🟢 Recovered 8 distinct msgs of 8
+*/
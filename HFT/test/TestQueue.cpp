@@ -1,11 +1,51 @@
-// g++ -std=c++20 TestQueue.cpp -o TestQueue -O3 -DQUEUE_CAPACITY=2048
+/*
+$ g++ -std=c++20 TestQueue.cpp -o TestQueue -O3 -DQUEUE_CAPACITY=2048
+$ ./TestQueue --pairs 2:3,2:5 --csv queue_bench.csv
+Options:
+    --pairs p:c,...     producer:consumer cores for the SPSC runs, -1 leaves a thread unpinned
+    --capacities n,...  queue capacities for the SPSC runs (powers of two)
+    --msgs N            messages per throughput run
+    --latency-msgs N    messages per paced latency run
+    --gap-ns N          producer gap between messages in the latency run
+    --max-threads N     largest producer count in the contention and logger sweeps
+    --csv FILE          append one row per run to FILE
+*/
 
 #include "../Queue.hpp"
+#include "BenchUtils.hpp"
+#include <thread>
+#include <chrono>
+#include <string_view>
+#include <sstream>
 
+struct BenchConfig {
+    std::vector<std::pair<int, int>> corePairs { {-1, -1} };
+    std::vector<size_t> capacities { 64, 1024, 16384 };
+    size_t msgs = 1 << 20;
+    size_t latencyMsgs = 100'000;
+    uint64_t gapNs = 1'000;
+    size_t maxThreads = 32;
+    std::string csvPath;
+};
+
+struct BenchMsg {
+    uint64_t tsc;
+    uint64_t seq;
+};
+using BenchMsgPtr = BenchMsg*;
+
+// LockedQueue::dequeue blocks while empty, consumers need a sentinel to leave
+template <typename Q> constexpr bool blockingDequeue = false;
+template <typename T> constexpr bool blockingDequeue<LockedQueue<T>> = true;
+
+const std::string csvHeader = "bench,queue,capacity,producer_cpu,consumer_cpu,producers,consumers,"
+    "msgs,elapsed_ns,mmsg_per_s,mean_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns,errors";
+
+/**************************************************************************/
 template <typename Q>
 void testQueue(const std::string& queueType) {
     std::cout << "Testing with " << queueType << "...\n";
-    
+
     Queue<Q> queue;
     double* msg1 = new double(5.0);
     double* msg2 = new double(6.0);
@@ -14,7 +54,7 @@ void testQueue(const std::string& queueType) {
     double* received1 = queue.dequeue();
     double* received2 = queue.dequeue();
     if (received1) {
-        std::cout << "Received: " << *received1 << std::endl;      
+        std::cout << "Received: " << *received1 << std::endl;
     } else {
         std::cout << "Queue received1 is empty." << std::endl;
     }
@@ -23,14 +63,419 @@ void testQueue(const std::string& queueType) {
     } else {
         std::cout << "Queue received2 is empty." << std::endl;
     }
-    delete received1, received2;
+    delete received1;
+    delete received2;
+}
+
+/**************************************************************************/
+void report(Bench::CsvWriter& csv, const std::string& bench, const std::string& queueType, size_t capacity,
+        std::pair<int, int> cores, size_t producers, size_t consumers, size_t msgs, uint64_t elapsedNs,
+        const Bench::LatencyHistogram& hist, size_t errors) {
+    const double mmsgs = elapsedNs ? (double)msgs * 1'000 / elapsedNs : 0.0;
+    std::cout << "\t" << (errors == 0 ? "🟢 " : "🔴 ") << bench << " cap:" << capacity <<
+        " cores:" << cores.first << ":" << cores.second << " p:" << producers << " c:" << consumers <<
+        " " << mmsgs << " Mmsg/s" << " p50:" << hist.percentile(50) << "ns p99:" << hist.percentile(99) <<
+        "ns p99.9:" << hist.percentile(99.9) << "ns max:" << hist.max() << "ns" <<
+        (errors ? " errors:" + std::to_string(errors) : "") << "\n";
+    csv.row(bench, queueType, capacity, cores.first, cores.second, producers, consumers, msgs, elapsedNs,
+        mmsgs, hist.mean(), hist.percentile(50), hist.percentile(90), hist.percentile(99),
+        hist.percentile(99.9), hist.max(), errors);
+}
+
+/**************************************************************************
+One producer and one consumer pinned to the given cores. Every message carries
+the producer TSC, the consumer records stamp-to-dequeue latency. With gapNs = 0
+the producer floods the queue (throughput, latency includes queueing delay),
+otherwise it paces sends so the histogram shows the handoff latency itself.
+**************************************************************************/
+template <typename Q>
+void spscRun(const std::string& queueType, const std::string& bench, Bench::CsvWriter& csv,
+        size_t capacity, std::pair<int, int> cores, size_t numMsgs, uint64_t gapNs) {
+    Queue<Q> queue(capacity);
+    std::vector<BenchMsg> payload(numMsgs);
+    std::atomic<bool> startFlag{false};
+    Bench::LatencyHistogram hist;
+    size_t errors = 0;
+    uint64_t startTsc = 0, endTsc = 0;
+    const uint64_t gapTicks = static_cast<uint64_t>(gapNs * Bench::tscPerNs());
+
+    std::thread consumer([&] {
+        Bench::pinThread(cores.second);
+        uint64_t expected = 0;
+        uint32_t spin = 0;
+        while (expected < numMsgs) {
+            if (BenchMsgPtr msg = queue.dequeue()) {
+                hist.record(Bench::tscToNs(Bench::rdtsc() - msg->tsc));
+                if (msg->seq != expected) ++errors;
+                ++expected;
+                spin = 0;
+            }
+            else if (++spin < 64) {
+                Bench::cpuRelax();
+            }
+            else {
+                std::this_thread::yield();
+                spin = 0;
+            }
+        }
+        endTsc = Bench::rdtsc();
+    });
+
+    std::thread producer([&] {
+        Bench::pinThread(cores.first);
+        while (!startFlag.load(std::memory_order_acquire)) { }
+        startTsc = Bench::rdtsc();
+        uint64_t next = startTsc;
+        for (size_t i = 0; i < numMsgs; ++i) {
+            if (gapTicks) {
+                while (Bench::rdtsc() < next) Bench::cpuRelax();
+                next += gapTicks;
+            }
+            BenchMsgPtr msg = &payload[i];
+            msg->seq = i;
+            msg->tsc = Bench::rdtsc();
+            while (!queue.enqueue(msg)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    startFlag.store(true, std::memory_order_release);
+    producer.join();
+    consumer.join();
+    report(csv, bench, queueType, capacity, cores, 1, 1, numMsgs, Bench::tscToNs(endTsc - startTsc), hist, errors);
+}
+
+/**************************************************************************/
+template <typename Q>
+void spscSuite(const std::string& queueType, const BenchConfig& cfg, Bench::CsvWriter& csv) {
+    std::cout << "SPSC suite with " << queueType << "...\n";
+    for (auto cores : cfg.corePairs) {
+        for (size_t capacity : cfg.capacities) {
+            spscRun<Q>(queueType, "spsc_throughput", csv, capacity, cores, cfg.msgs, 0);
+            spscRun<Q>(queueType, "spsc_latency", csv, capacity, cores, cfg.latencyMsgs, cfg.gapNs);
+        }
+    }
+}
+
+/**************************************************************************
+Producers x consumers sweep at the default capacity. Shapes are N:1 (the
+AsyncLogger pattern) and N:N, up to maxConsumers consumers. Threads are left
+unpinned, the scheduler decides placement as it would in production.
+**************************************************************************/
+template <typename Q>
+void contentionRun(const std::string& queueType, Bench::CsvWriter& csv,
+        size_t numProducers, size_t numConsumers, size_t totalMsgs) {
+    Queue<Q> queue;
+    const size_t msgsPerProducer = totalMsgs / numProducers;
+    const size_t numMsgs = msgsPerProducer * numProducers;
+    std::vector<BenchMsg> payload(numMsgs);
+    BenchMsg stopMsg{};
+    std::atomic<bool> startFlag{false};
+    std::atomic<bool> producersDone{false};
+    std::vector<Bench::LatencyHistogram> hists(numConsumers);
+    std::vector<size_t> received(numConsumers, 0);
+
+    auto producer = [&](size_t producerId) {
+        while (!startFlag.load(std::memory_order_acquire)) { }
+        for (size_t i = 0; i < msgsPerProducer; ++i) {
+            BenchMsgPtr msg = &payload[producerId * msgsPerProducer + i];
+            msg->seq = i;
+            msg->tsc = Bench::rdtsc();
+            while (!queue.enqueue(msg)) {
+                std::this_thread::yield();
+            }
+        }
+    };
+    auto consumer = [&](size_t consumerId) {
+        auto& hist = hists[consumerId];
+        size_t count = 0;
+        while (true) {
+            BenchMsgPtr msg = queue.dequeue();
+            if (msg == &stopMsg) {
+                break;
+            }
+            else if (msg) {
+                hist.record(Bench::tscToNs(Bench::rdtsc() - msg->tsc));
+                ++count;
+            }
+            else if (producersDone.load(std::memory_order_acquire)) {
+                if (!(msg = queue.dequeue())) break; // producers finished and the queue is drained
+                hist.record(Bench::tscToNs(Bench::rdtsc() - msg->tsc));
+                ++count;
+            }
+            else {
+                std::this_thread::yield();
+            }
+        }
+        received[consumerId] = count;
+    };
+
+    std::vector<std::thread> consumers, producers;
+    for (size_t c = 0; c < numConsumers; ++c) consumers.emplace_back(consumer, c);
+    for (size_t p = 0; p < numProducers; ++p) producers.emplace_back(producer, p);
+
+    auto start = std::chrono::steady_clock::now();
+    startFlag.store(true, std::memory_order_release);
+    for (auto& thr : producers) thr.join();
+    producersDone.store(true, std::memory_order_release);
+    if constexpr (blockingDequeue<Q>) {
+        for (size_t c = 0; c < numConsumers; ++c) queue.enqueue(&stopMsg);
+    }
+    for (auto& thr : consumers) thr.join();
+    auto end = std::chrono::steady_clock::now();
+
+    Bench::LatencyHistogram hist;
+    size_t total = 0;
+    for (size_t c = 0; c < numConsumers; ++c) {
+        hist.merge(hists[c]);
+        total += received[c];
+    }
+    const uint64_t elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    report(csv, "contention", queueType, Const::queueCapacity, {-1, -1}, numProducers, numConsumers,
+        numMsgs, elapsedNs, hist, numMsgs - total);
+}
+
+template <typename Q>
+void contentionSweep(const std::string& queueType, const BenchConfig& cfg, Bench::CsvWriter& csv,
+        size_t maxConsumers) {
+    std::cout << "Contention sweep with " << queueType << "...\n";
+    for (size_t producers = 1; producers <= cfg.maxThreads; producers *= 2) {
+        contentionRun<Q>(queueType, csv, producers, 1, cfg.msgs);
+        if (producers > 1 && producers <= maxConsumers) {
+            contentionRun<Q>(queueType, csv, producers, producers, cfg.msgs);
+        }
+    }
 }
 
-int main() {
-    
+/**************************************************************************
+AsyncLogger shaped workload: N producers format a line into their own message
+and push it, one consumer drains. producerBatch > 1 formats that many lines
+before a single enqueueBulk, consumerBatch > 1 drains with dequeueBulk.
+**************************************************************************/
+struct LogLine {
+    char buffer[120];
+    size_t len;
+};
+using LogLinePtr = LogLine*;
+
+template <typename Q>
+void loggerRun(const std::string& queueType, Bench::CsvWriter& csv, size_t numProducers,
+        size_t totalMsgs, size_t producerBatch, size_t consumerBatch) {
+    Queue<Q> queue;
+    const size_t msgsPerProducer = (totalMsgs / numProducers / producerBatch) * producerBatch;
+    const size_t numMsgs = msgsPerProducer * numProducers;
+    std::vector<LogLine> lines(numMsgs);
+    std::atomic<bool> startFlag{false};
+    std::atomic<uint64_t> producerNs{0};
+
+    auto producer = [&](size_t producerId) {
+        std::vector<LogLinePtr> batch(producerBatch);
+        while (!startFlag.load(std::memory_order_acquire)) { }
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < msgsPerProducer; i += producerBatch) {
+            for (size_t b = 0; b < producerBatch; ++b) {
+                LogLinePtr line = &lines[producerId * msgsPerProducer + i + b];
+                line->len = std::snprintf(line->buffer, sizeof(line->buffer),
+                    "Thread %zu: MessageID = %zu\n", producerId, i + b);
+                batch[b] = line;
+            }
+            size_t sent = 0;
+            while (sent < producerBatch) {
+                size_t n = (producerBatch == 1) ? queue.enqueue(batch[0]) :
+                    queue.enqueueBulk(batch.data() + sent, producerBatch - sent);
+                if (n == 0) std::this_thread::yield();
+                sent += n;
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+        producerNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    };
+
+    std::vector<std::thread> producers;
+    for (size_t p = 0; p < numProducers; ++p) producers.emplace_back(producer, p);
+
+    std::vector<LogLinePtr> drained(consumerBatch);
+    size_t received = 0, bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    startFlag.store(true, std::memory_order_release);
+    while (received < numMsgs) {
+        size_t n = (consumerBatch == 1) ? ((drained[0] = queue.dequeue()) != nullptr) :
+            queue.dequeueBulk(drained.data(), consumerBatch);
+        if (n == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        for (size_t i = 0; i < n; ++i) bytes += drained[i]->len;
+        received += n;
+    }
+    auto end = std::chrono::steady_clock::now();
+    for (auto& thr : producers) thr.join();
+
+    const uint64_t elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    const std::string variant = queueType + " pb:" + std::to_string(producerBatch) + 
+        " cb:" + std::to_string(consumerBatch);
+    std::cout << "\t🟢 logger " << variant << " p:" << numProducers << " " <<
+        ((double)numMsgs * 1'000 / elapsedNs) << " Mmsg/s, caller side " << 
+        ((double)producerNs.load() / numMsgs) << " ns/msg\n";
+    csv.row("logger", variant, Const::queueCapacity, -1, -1, numProducers, 1, numMsgs, elapsedNs,
+        (double)numMsgs * 1'000 / elapsedNs, (double)producerNs.load() / numMsgs, 0, 0, 0, 0, 0, numMsgs - received);
+    (void)bytes; // touched so the consumer reads every line
+}
+
+template <typename Q>
+void loggerSweep(const std::string& queueType, const BenchConfig& cfg, Bench::CsvWriter& csv,
+        size_t producerBatch = 1, size_t consumerBatch = 1) {
+    std::cout << "Logger workload with " << queueType << "...\n";
+    for (size_t producers = 1; producers <= cfg.maxThreads; producers *= 2) {
+        loggerRun<Q>(queueType, csv, producers, cfg.msgs / 4, producerBatch, consumerBatch);
+    }
+}
+
+/**************************************************************************
+Control message latency while the data lane is saturated. A data producer keeps
+the queue full, a control producer sends a stamped message every controlGapNs
+and the consumer spends consumerWorkNs per message so it is the bottleneck.
+Q is either a PriorityLaneQueue (control on lane 0) or a plain FIFO baseline
+shared by both producers.
+**************************************************************************/
+template <typename Q>
+void priorityRun(const std::string& queueType, const BenchConfig& cfg, Bench::CsvWriter& csv) {
+    constexpr uint64_t controlGapNs = 20'000;
+    constexpr uint64_t consumerWorkNs = 100;
+    const size_t numControl = std::max<size_t>(cfg.latencyMsgs / 100, 100);
+
+    Q queue;
+    std::vector<BenchMsg> control(numControl);
+    BenchMsg data{}; // payload of the data lane is never inspected
+    std::atomic<bool> startFlag{false};
+    std::atomic<bool> stopFlag{false};
+    Bench::LatencyHistogram hist;
+    size_t dataReceived = 0;
+
+    auto enqueueControl = [&](BenchMsgPtr msg) {
+        if constexpr (requires { queue.enqueue(msg, size_t{0}); }) return queue.enqueue(msg, 0);
+        else return queue.enqueue(msg);
+    };
+
+    std::thread dataProducer([&] {
+        while (!startFlag.load(std::memory_order_acquire)) { }
+        while (!stopFlag.load(std::memory_order_relaxed)) {
+            if (!queue.enqueue(&data)) Bench::cpuRelax();
+        }
+    });
+    std::thread controlProducer([&] {
+        const uint64_t gapTicks = static_cast<uint64_t>(controlGapNs * Bench::tscPerNs());
+        while (!startFlag.load(std::memory_order_acquire)) { }
+        uint64_t next = Bench::rdtsc() + gapTicks;
+        for (size_t i = 0; i < numControl; ++i) {
+            while (Bench::rdtsc() < next) Bench::cpuRelax();
+            next += gapTicks;
+            control[i].seq = i;
+            control[i].tsc = Bench::rdtsc();
+            while (!enqueueControl(&control[i])) Bench::cpuRelax();
+        }
+    });
+
+    const uint64_t workTicks = static_cast<uint64_t>(consumerWorkNs * Bench::tscPerNs());
+    size_t controlReceived = 0;
+    auto start = std::chrono::steady_clock::now();
+    startFlag.store(true, std::memory_order_release);
+    while (controlReceived < numControl) {
+        BenchMsgPtr msg = queue.dequeue();
+        if (!msg) continue;
+        if (msg == &data) {
+            const uint64_t until = Bench::rdtsc() + workTicks;
+            while (Bench::rdtsc() < until) { }
+            ++dataReceived;
+        }
+        else {
+            hist.record(Bench::tscToNs(Bench::rdtsc() - msg->tsc));
+            ++controlReceived;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    stopFlag.store(true, std::memory_order_relaxed);
+    controlProducer.join();
+    dataProducer.join();
+
+    const uint64_t elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    report(csv, "priority_control", queueType, Const::queueCapacity, {-1, -1}, 2, 1, numControl + dataReceived,
+        elapsedNs, hist, 0);
+}
+
+/**************************************************************************/
+BenchConfig parseArgs(int argc, char** argv) {
+    BenchConfig cfg;
+    auto split = [](const std::string& s) {
+        std::vector<std::string> out;
+        std::stringstream ss(s);
+        for (std::string item; std::getline(ss, item, ',');) out.push_back(item);
+        return out;
+    };
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string_view key = argv[i];
+        std::string value = argv[i + 1];
+        if (key == "--pairs") {
+            cfg.corePairs.clear();
+            for (auto& pair : split(value)) {
+                auto colon = pair.find(':');
+                if (colon == std::string::npos) throw std::invalid_argument("--pairs expects p:c");
+                cfg.corePairs.emplace_back(std::stoi(pair.substr(0, colon)), std::stoi(pair.substr(colon + 1)));
+            }
+        }
+        else if (key == "--capacities") {
+            cfg.capacities.clear();
+            for (auto& cap : split(value)) cfg.capacities.push_back(std::stoul(cap));
+        }
+        else if (key == "--msgs") cfg.msgs = std::stoul(value);
+        else if (key == "--latency-msgs") cfg.latencyMsgs = std::stoul(value);
+        else if (key == "--gap-ns") cfg.gapNs = std::stoul(value);
+        else if (key == "--max-threads") cfg.maxThreads = std::stoul(value);
+        else if (key == "--csv") cfg.csvPath = value;
+        else throw std::invalid_argument("Unknown option " + std::string(key));
+    }
+    return cfg;
+}
+
+int main(int argc, char** argv) {
+
     testQueue<LockedQueue<double*>>("LockedQueue");
     testQueue<CustomSPSCLockFreeQueue<double*>>("CustomSPSCLockFreeQueue");
     testQueue<CustomMPMCLockFreeQueue<double*>>("CustomMPMCLockFreeQueue");
     testQueue<BoostLockFreeQueue<double*>>("BoostLockFreeQueue");
     testQueue<MoodycamelLockFreeQueue<double*>>("MoodycamelLockFreeQueue");
+    testQueue<CustomMPSCLockFreeQueue<double*>>("CustomMPSCLockFreeQueue");
+    testQueue<PriorityLaneQueue<double*>>("PriorityLaneQueue");
+
+    const BenchConfig cfg = parseArgs(argc, argv);
+    Bench::CsvWriter csv(cfg.csvPath, csvHeader);
+
+    spscSuite<LockedQueue<BenchMsgPtr>>("LockedQueue", cfg, csv);
+    spscSuite<CustomSPSCLockFreeQueue<BenchMsgPtr>>("CustomSPSCLockFreeQueue", cfg, csv);
+    spscSuite<CustomMPMCLockFreeQueue<BenchMsgPtr>>("CustomMPMCLockFreeQueue", cfg, csv);
+    spscSuite<CustomMPSCLockFreeQueue<BenchMsgPtr>>("CustomMPSCLockFreeQueue", cfg, csv);
+    spscSuite<BoostLockFreeQueue<BenchMsgPtr>>("BoostLockFreeQueue", cfg, csv);
+    spscSuite<MoodycamelLockFreeQueue<BenchMsgPtr>>("MoodycamelLockFreeQueue", cfg, csv);
+
+    contentionSweep<LockedQueue<BenchMsgPtr>>("LockedQueue", cfg, csv, cfg.maxThreads);
+    contentionSweep<CustomMPMCLockFreeQueue<BenchMsgPtr>>("CustomMPMCLockFreeQueue", cfg, csv, cfg.maxThreads);
+    contentionSweep<CustomMPMCLockFreeQueue<BenchMsgPtr, true>>("CustomMPMCLockFreeQueue<padded>", cfg, csv,
+        cfg.maxThreads);
+    contentionSweep<CustomMPSCLockFreeQueue<BenchMsgPtr>>("CustomMPSCLockFreeQueue", cfg, csv, 1);
+    contentionSweep<BoostLockFreeQueue<BenchMsgPtr>>("BoostLockFreeQueue", cfg, csv, cfg.maxThreads);
+    contentionSweep<MoodycamelLockFreeQueue<BenchMsgPtr>>("MoodycamelLockFreeQueue", cfg, csv, cfg.maxThreads);
+    contentionSweep<MoodycamelLockFreeQueue<BenchMsgPtr, true>>("MoodycamelLockFreeQueue<tokens>", cfg, csv,
+        cfg.maxThreads);
+
+    std::cout << "Control latency under a saturated data lane...\n";
+    priorityRun<CustomMPSCLockFreeQueue<BenchMsgPtr>>("CustomMPSCLockFreeQueue<fifo>", cfg, csv);
+    priorityRun<PriorityLaneQueue<BenchMsgPtr, 2, LanePolicy::Strict>>("PriorityLaneQueue<strict>", cfg, csv);
+    priorityRun<PriorityLaneQueue<BenchMsgPtr, 2, LanePolicy::Weighted>>("PriorityLaneQueue<weighted>", cfg, csv);
+
+    loggerSweep<CustomMPSCLockFreeQueue<LogLinePtr>>("CustomMPSCLockFreeQueue", cfg, csv);
+    loggerSweep<MoodycamelLockFreeQueue<LogLinePtr>>("MoodycamelLockFreeQueue", cfg, csv);
+    loggerSweep<MoodycamelLockFreeQueue<LogLinePtr, true>>("MoodycamelLockFreeQueue<tokens>", cfg, csv);
+    loggerSweep<MoodycamelLockFreeQueue<LogLinePtr, true>>("MoodycamelLockFreeQueue<tokens>", cfg, csv, 1, 64);
+    loggerSweep<MoodycamelLockFreeQueue<LogLinePtr, true>>("MoodycamelLockFreeQueue<tokens>", cfg, csv, 8, 64);
 }
@@ -0,0 +1,152 @@
+/*
+$ g++ -std=c++20 -O3 -o TestShmQueue TestShmQueue.cpp -I../ -lrt
+$ numactl --physcpubind=4,5 ./TestShmQueue
+*/
+
+#include "ShmQueue.hpp"
+#include "ITCHMessages.hpp"
+#include "BenchUtils.hpp"
+#include <sys/wait.h>
+
+namespace Const {
+    constexpr size_t shmTestMsgCount = 1'000'000;
+};
+
+const std::string shmName = "/TestShmQueue_" + std::to_string(::getpid());
+
+/**************************************************************************
+The child process attaches as the consumer, checks the sequence numbers and
+reports the producer-stamp to dequeue latency. Exit code 0 means no gaps.
+**************************************************************************/
+int runConsumer() {
+    std::unique_ptr<ShmSPSCQueue<ITCHTradeMsg>> queue;
+    for (int attempt = 0; !queue; ++attempt) {
+        try {
+            queue = std::make_unique<ShmSPSCQueue<ITCHTradeMsg>>(shmName, ShmRole::Consumer);
+        } catch (const std::exception&) {
+            if (attempt > 100) throw;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    Bench::LatencyHistogram hist;
+    uint64_t expected = 0, gaps = 0, idle = 0;
+    while (expected < Const::shmTestMsgCount) {
+        const ITCHTradeMsg* msg = queue->front();
+        if (!msg) {
+            if ((++idle & 0xFFFF) == 0 && !queue->isPeerAlive()) { // kill() is a syscall, poll it rarely
+                std::cout << "\t🔴 Producer died at sequence " << expected << "\n";
+                return 1;
+            }
+            continue;
+        }
+        hist.record(Bench::tscToNs(Bench::rdtsc() - msg->timestamp));
+        if (msg->sequence_number != expected) ++gaps;
+        expected = msg->sequence_number + 1;
+        queue->pop();
+    }
+    std::cout << "\t" << (gaps == 0 ? "🟢" : "🔴") << " Consumer received " << expected << " msgs, gaps: " << gaps <<
+        " p50:" << hist.percentile(50) << "ns p99:" << hist.percentile(99) << "ns max:" << hist.max() << "ns\n";
+    return gaps == 0 ? 0 : 1;
+}
+
+/**************************************************************************/
+void testTransfer() {
+    std::cout << "Testing ShmSPSCQueue transfer across processes...\n";
+    ShmSPSCQueue<ITCHTradeMsg> queue(shmName, ShmRole::Producer);
+    Bench::tscPerNs(); // calibrate before forking so both sides share the value
+
+    std::cout.flush(); // do not duplicate buffered output in the child
+    pid_t child = ::fork();
+    if (child == 0) {
+        int rc = runConsumer();
+        std::cout.flush();
+        ::_exit(rc);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t seq = 0; seq < Const::shmTestMsgCount; ++seq) {
+        ITCHTradeMsg* slot = nullptr;
+        while (!(slot = queue.claim())) { }
+        slot->message_type = 'P';
+        slot->sequence_number = seq;
+        slot->trade_id = seq;
+        slot->price = 100.0;
+        slot->quantity = 1.0;
+        slot->timestamp = Bench::rdtsc();
+        queue.publish();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    int status = 0;
+    ::waitpid(child, &status, 0);
+    auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    std::cout << "\t🟢 Producer sent " << Const::shmTestMsgCount << " msgs in " << elapsed_ns / 1'000'000 << " ms " <<
+        ((double)elapsed_ns / Const::shmTestMsgCount) << " ns/msg\n";
+    std::cout << "\t" << (WIFEXITED(status) && WEXITSTATUS(status) == 0 ? "🟢 Consumer verified all messages" :
+        "🔴 Consumer reported an error") << "\n";
+}
+
+/**************************************************************************/
+void testLiveness() {
+    std::cout << "Testing ShmSPSCQueue liveness detection...\n";
+    ShmSPSCQueue<ITCHTradeMsg> queue(shmName, ShmRole::Producer, 16);
+    std::cout << "\t" << (!queue.isPeerAttached() ? "🟢" : "🔴") << " No consumer attached after create\n";
+
+    std::cout.flush();
+    pid_t child = ::fork();
+    if (child == 0) {
+        ShmSPSCQueue<ITCHTradeMsg> consumer(shmName, ShmRole::Consumer);
+        ITCHTradeMsg msg{};
+        while (!consumer.dequeue(msg)) { }
+        std::_Exit(msg.sequence_number == 7 ? 0 : 1); // crash-like exit, no detach
+    }
+
+    ITCHTradeMsg msg{};
+    msg.sequence_number = 7;
+    queue.enqueue(msg);
+    int status = 0;
+    ::waitpid(child, &status, 0);
+    std::cout << "\t" << (WIFEXITED(status) && WEXITSTATUS(status) == 0 ? "🟢" : "🔴") <<
+        " Consumer received the message\n";
+    std::cout << "\t" << (queue.isPeerAttached() && !queue.isPeerAlive() ? "🟢" : "🔴") <<
+        " Dead consumer detected\n";
+
+    for (size_t i = 0; i < queue.capacity(); ++i) queue.enqueue(msg);
+    std::cout << "\t" << (!queue.enqueue(msg) ? "🟢" : "🔴") << " Full queue rejects enqueue\n";
+
+    ShmSPSCQueue<ITCHTradeMsg> restarted(shmName, ShmRole::Consumer); // takes over from the dead consumer
+    std::cout << "\t" << (restarted.isPeerAlive() && restarted.size() == queue.capacity() ? "🟢" : "🔴") <<
+        " Restarted consumer resumes with " << restarted.size() << " pending msgs\n";
+}
+
+/**************************************************************************/
+void testProducerTakeover() {
+    std::cout << "Testing ShmSPSCQueue producer takeover...\n";
+    std::cout.flush();
+    pid_t child = ::fork();
+    if (child == 0) {
+        ShmSPSCQueue<ITCHTradeMsg> crashed(shmName, ShmRole::Producer, 16);
+        std::_Exit(0); // crash-like exit, the segment stays behind
+    }
+    int status = 0;
+    ::waitpid(child, &status, 0);
+
+    ShmSPSCQueue<ITCHTradeMsg> queue(shmName, ShmRole::Producer, 16);
+    std::cout << "\t" << (queue.size() == 0 ? "🟢" : "🔴") << " Segment of a dead producer replaced\n";
+    try {
+        ShmSPSCQueue<ITCHTradeMsg> second(shmName, ShmRole::Producer, 16);
+        std::cout << "\t🔴 Second producer replaced a live segment\n";
+    } catch (const std::exception& e) {
+        std::cout << "\t🟢 Second producer rejected: " << e.what() << "\n";
+    }
+    ShmSPSCQueue<ITCHTradeMsg> consumer(shmName, ShmRole::Consumer);
+    std::cout << "\t" << (consumer.isPeerAlive() ? "🟢" : "🔴") << " Consumer still attaches to the live segment\n";
+}
+
+int main() {
+    testTransfer();
+    testLiveness();
+    testProducerTakeover();
+    return 0;
+}